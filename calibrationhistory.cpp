@@ -0,0 +1,375 @@
+#include "calibrationhistory.h"
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QSet>
+#include <QDebug>
+
+static const quint32 LOG_MAGIC = 0x43484C47;   // "CHLG"
+static const quint32 INDEX_MAGIC = 0x43484958; // "CHIX"
+static const quint16 FORMAT_VERSION = 1;
+static const quint8 ENTRY_KEYFRAME = 0;
+static const quint8 ENTRY_DELTA = 1;
+
+// ключ области: координаты упакованы в одно число
+static quint64 regionKey(int x1, int y1, int x2, int y2) {
+    return (quint64(quint16(x1)) << 48) | (quint64(quint16(y1)) << 32)
+         | (quint64(quint16(x2)) << 16) | quint64(quint16(y2));
+}
+
+static quint64 regionKey(const CsvHandler::Record &r) {
+    return regionKey(r.x1, r.y1, r.x2, r.y2);
+}
+
+static void setupStream(QDataStream &s) {
+    s.setVersion(QDataStream::Qt_5_12);
+}
+
+static void writeRecord(QDataStream &out, const CsvHandler::Record &r) {
+    out << qint32(r.x1) << qint32(r.y1) << qint32(r.x2) << qint32(r.y2) << r.azimuth << r.elevation;
+}
+
+static void readRecord(QDataStream &in, CsvHandler::Record &r) {
+    qint32 x1 = 0, y1 = 0, x2 = 0, y2 = 0;
+    in >> x1 >> y1 >> x2 >> y2 >> r.azimuth >> r.elevation;
+    r.x1 = x1; r.y1 = y1; r.x2 = x2; r.y2 = y2;
+}
+
+static void writeHeader(QDataStream &out, const CsvHandler::Header &h) {
+    out << qint32(h.machineNumber) << h.date << h.time << qint32(h.version) << h.commentTextLines;
+}
+
+static void readHeader(QDataStream &in, CsvHandler::Header &h) {
+    qint32 machine = 0, version = 0;
+    in >> machine >> h.date >> h.time >> version >> h.commentTextLines;
+    h.machineNumber = machine;
+    h.version = version;
+}
+
+// дельта версии: удалённые позиции предыдущей версии, новые смещения
+// по позициям новой версии и записи, добавленные в конец
+struct Delta {
+    struct Offset { qint32 pos; double azimuth; double elevation; };
+    QVector<qint32> removed;
+    QVector<Offset> changed;
+    QVector<CsvHandler::Record> added;
+
+    int size() const { return removed.size() + changed.size() + added.size(); }
+};
+
+// false, если новую версию нельзя выразить дельтой (дубли областей или другой порядок)
+static bool computeDelta(const QVector<CsvHandler::Record> &prev, const QVector<CsvHandler::Record> &cur, Delta &d) {
+    QHash<quint64, int> prevPos;
+    prevPos.reserve(prev.size());
+    for (int i = 0; i < prev.size(); ++i) {
+        quint64 k = regionKey(prev[i]);
+        if (prevPos.contains(k)) return false;
+        prevPos.insert(k, i);
+    }
+
+    QVector<bool> matched(prev.size(), false);
+    QSet<quint64> seen;
+    seen.reserve(cur.size());
+    int lastPrev = -1;
+    bool inAdded = false;
+    for (int i = 0; i < cur.size(); ++i) {
+        const CsvHandler::Record &r = cur[i];
+        quint64 k = regionKey(r);
+        if (seen.contains(k)) return false;
+        seen.insert(k);
+        auto it = prevPos.constFind(k);
+        if (it == prevPos.constEnd()) {
+            inAdded = true;
+            d.added.append(r);
+            continue;
+        }
+        if (inAdded || it.value() < lastPrev) return false;
+        lastPrev = it.value();
+        matched[it.value()] = true;
+        const CsvHandler::Record &p = prev[it.value()];
+        if (p.azimuth != r.azimuth || p.elevation != r.elevation) d.changed.append({i, r.azimuth, r.elevation});
+    }
+    for (int i = 0; i < prev.size(); ++i) {
+        if (!matched[i]) d.removed.append(i);
+    }
+    return true;
+}
+
+CalibrationHistory::CalibrationHistory(const QString &directory, int keyframeInterval)
+    : dir(directory)
+    , interval(qMax(1, keyframeInterval))
+{}
+
+QString CalibrationHistory::logPath() const {
+    return QDir(dir).filePath(QString("%1.hist").arg(machine));
+}
+
+QString CalibrationHistory::indexPath() const {
+    return QDir(dir).filePath(QString("%1.idx").arg(machine));
+}
+
+bool CalibrationHistory::open(int machineNumber, QString &outError) {
+    machine = machineNumber;
+    entries.clear();
+    regionIndex.clear();
+    last = CsvHandler::Result{};
+    if (!QDir().mkpath(dir)) { outError = "Не удалось создать каталог истории: " + dir; return false; }
+
+    QFileInfo info(logPath());
+    if (!info.exists()) return true;
+    if (loadIndex(info.size())) {
+        qDebug() << "история: индекс загружен, версий:" << entries.size();
+        return entries.isEmpty() || reconstruct(entries.size() - 1, last, outError);
+    }
+    qDebug() << "история: индекс устарел, перестраиваем" << logPath();
+    return rebuildIndex(outError);
+}
+
+bool CalibrationHistory::append(const CsvHandler::Result &result, QString &outError) {
+    if (machine < 0) { outError = "История не открыта"; return false; }
+    if (result.header.machineNumber != machine) {
+        outError = QString("Файл машины %1 не относится к истории машины %2").arg(result.header.machineNumber).arg(machine);
+        return false;
+    }
+
+    int sinceKeyframe = 0;
+    for (int i = entries.size() - 1; i >= 0 && !entries[i].keyframe; --i) ++sinceKeyframe;
+    Delta d;
+    bool keyframe = entries.isEmpty()
+                    || sinceKeyframe + 1 >= interval
+                    || !computeDelta(last.records, result.records, d)
+                    || d.size() >= result.records.size();
+
+    QFile f(logPath());
+    if (!f.open(QIODevice::WriteOnly | QIODevice::Append)) { outError = "Не удалось открыть журнал истории"; return false; }
+    // размер до записи: при сбое журнал обрезается обратно, чтобы не оставить неполную запись
+    const qint64 start = f.size();
+    QDataStream out(&f);
+    setupStream(out);
+    if (start == 0) out << LOG_MAGIC << FORMAT_VERSION;
+
+    Version v;
+    v.offset = f.size();
+    v.keyframe = keyframe;
+    v.date = result.header.date;
+    v.time = result.header.time;
+
+    out << (keyframe ? ENTRY_KEYFRAME : ENTRY_DELTA);
+    writeHeader(out, result.header);
+    if (keyframe) {
+        out << qint32(result.records.size());
+        for (const auto &r : result.records) writeRecord(out, r);
+    } else {
+        out << qint32(d.removed.size());
+        for (qint32 pos : d.removed) out << pos;
+        out << qint32(d.changed.size());
+        for (const auto &c : d.changed) out << c.pos << c.azimuth << c.elevation;
+        out << qint32(d.added.size());
+        for (const auto &r : d.added) writeRecord(out, r);
+    }
+    if (out.status() != QDataStream::Ok || !f.flush()) {
+        outError = "Ошибка записи журнала истории";
+        f.close();
+        if (!QFile::resize(logPath(), start)) outError += ", журнал не удалось обрезать";
+        return false;
+    }
+    f.close();
+
+    entries.append(v);
+    indexChanges(entries.size() - 1, last, result);
+    last = result;
+    qDebug() << "история: версия" << entries.size() - 1 << (keyframe ? "ключевой кадр" : "дельта") << "изменений:" << d.size();
+    return saveIndex(outError);
+}
+
+bool CalibrationHistory::reconstruct(int version, CsvHandler::Result &outResult, QString &outError) const {
+    if (version < 0 || version >= entries.size()) { outError = QString("Нет версии %1").arg(version); return false; }
+    if (version == entries.size() - 1 && !last.records.isEmpty()) { outResult = last; return true; }
+
+    int start = version;
+    while (start > 0 && !entries[start].keyframe) --start;
+
+    QFile f(logPath());
+    if (!f.open(QIODevice::ReadOnly)) { outError = "Не удалось открыть журнал истории"; return false; }
+    if (!f.seek(entries[start].offset)) { outError = "Повреждён журнал истории"; return false; }
+    QDataStream in(&f);
+    setupStream(in);
+
+    CsvHandler::Result state;
+    for (int i = start; i <= version; ++i) {
+        bool keyframe = false;
+        if (!readEntry(in, state, keyframe, outError)) return false;
+    }
+    outResult = state;
+    return true;
+}
+
+QVector<CalibrationHistory::Change> CalibrationHistory::regionChanges(int x1, int y1, int x2, int y2) const {
+    return regionIndex.value(regionKey(x1, y1, x2, y2));
+}
+
+bool CalibrationHistory::readEntry(QDataStream &in, CsvHandler::Result &state, bool &keyframe, QString &outError) const {
+    quint8 kind = 0;
+    in >> kind;
+    readHeader(in, state.header);
+    if (kind == ENTRY_KEYFRAME) {
+        keyframe = true;
+        qint32 n = 0;
+        in >> n;
+        if (n < 0) { outError = "Повреждён журнал истории"; return false; }
+        state.records.resize(n);
+        for (auto &r : state.records) readRecord(in, r);
+    } else if (kind == ENTRY_DELTA) {
+        keyframe = false;
+        qint32 n = 0;
+        in >> n;
+        QVector<bool> removed(state.records.size(), false);
+        for (qint32 i = 0; i < n; ++i) {
+            qint32 pos = -1;
+            in >> pos;
+            if (pos < 0 || pos >= removed.size()) { outError = "Повреждён журнал истории"; return false; }
+            removed[pos] = true;
+        }
+        QVector<CsvHandler::Record> records;
+        records.reserve(state.records.size());
+        for (int i = 0; i < state.records.size(); ++i) {
+            if (!removed[i]) records.append(state.records[i]);
+        }
+        in >> n;
+        for (qint32 i = 0; i < n; ++i) {
+            qint32 pos = -1;
+            double az = 0.0, el = 0.0;
+            in >> pos >> az >> el;
+            if (pos < 0 || pos >= records.size()) { outError = "Повреждён журнал истории"; return false; }
+            records[pos].azimuth = az;
+            records[pos].elevation = el;
+        }
+        in >> n;
+        for (qint32 i = 0; i < n; ++i) {
+            CsvHandler::Record r;
+            readRecord(in, r);
+            records.append(r);
+        }
+        state.records = records;
+    } else {
+        outError = QString("Неизвестный тип записи журнала: %1").arg(kind);
+        return false;
+    }
+    if (in.status() != QDataStream::Ok) { outError = "Повреждён журнал истории"; return false; }
+    return true;
+}
+
+void CalibrationHistory::indexChanges(int version, const CsvHandler::Result &prev, const CsvHandler::Result &cur) {
+    QHash<quint64, const CsvHandler::Record*> before;
+    before.reserve(prev.records.size());
+    for (const auto &r : prev.records) before.insert(regionKey(r), &r);
+
+    QSet<quint64> present;
+    present.reserve(cur.records.size());
+    for (const auto &r : cur.records) {
+        quint64 k = regionKey(r);
+        present.insert(k);
+        auto it = before.constFind(k);
+        if (it == before.constEnd()) {
+            regionIndex[k].append({version, ChangeKind::Added, r.azimuth, r.elevation});
+        } else if (it.value()->azimuth != r.azimuth || it.value()->elevation != r.elevation) {
+            regionIndex[k].append({version, ChangeKind::Changed, r.azimuth, r.elevation});
+        }
+    }
+    for (auto it = before.constBegin(); it != before.constEnd(); ++it) {
+        if (!present.contains(it.key())) {
+            regionIndex[it.key()].append({version, ChangeKind::Removed, it.value()->azimuth, it.value()->elevation});
+        }
+    }
+}
+
+bool CalibrationHistory::rebuildIndex(QString &outError) {
+    entries.clear();
+    regionIndex.clear();
+    last = CsvHandler::Result{};
+
+    QFile f(logPath());
+    if (!f.open(QIODevice::ReadOnly)) { outError = "Не удалось открыть журнал истории"; return false; }
+    QDataStream in(&f);
+    setupStream(in);
+    quint32 magic = 0;
+    quint16 format = 0;
+    in >> magic >> format;
+    if (magic != LOG_MAGIC || format != FORMAT_VERSION) { outError = "Неизвестный формат журнала истории"; return false; }
+
+    CsvHandler::Result state;
+    while (!in.atEnd()) {
+        Version v;
+        v.offset = f.pos();
+        CsvHandler::Result prev = state;
+        if (!readEntry(in, state, v.keyframe, outError)) return false;
+        v.date = state.header.date;
+        v.time = state.header.time;
+        entries.append(v);
+        indexChanges(entries.size() - 1, prev, state);
+    }
+    last = state;
+    return saveIndex(outError);
+}
+
+bool CalibrationHistory::loadIndex(qint64 logSize) {
+    QFile f(indexPath());
+    if (!f.open(QIODevice::ReadOnly)) return false;
+    QDataStream in(&f);
+    setupStream(in);
+
+    quint32 magic = 0;
+    quint16 format = 0;
+    qint64 indexedSize = -1;
+    qint32 indexedMachine = -1;
+    in >> magic >> format >> indexedSize >> indexedMachine;
+    if (magic != INDEX_MAGIC || format != FORMAT_VERSION || indexedSize != logSize || indexedMachine != machine) return false;
+
+    qint32 n = 0;
+    in >> n;
+    entries.resize(qMax(0, n));
+    for (auto &v : entries) in >> v.offset >> v.keyframe >> v.date >> v.time;
+
+    qint32 keys = 0;
+    in >> keys;
+    for (qint32 i = 0; i < keys && in.status() == QDataStream::Ok; ++i) {
+        quint64 key = 0;
+        qint32 count = 0;
+        in >> key >> count;
+        QVector<Change> &changes = regionIndex[key];
+        changes.resize(qMax(0, count));
+        for (auto &c : changes) {
+            qint32 version = 0;
+            quint8 kind = 0;
+            in >> version >> kind >> c.azimuth >> c.elevation;
+            c.version = version;
+            c.kind = static_cast<ChangeKind>(kind);
+        }
+    }
+    if (in.status() != QDataStream::Ok) {
+        entries.clear();
+        regionIndex.clear();
+        return false;
+    }
+    return true;
+}
+
+bool CalibrationHistory::saveIndex(QString &outError) const {
+    QSaveFile f(indexPath());
+    if (!f.open(QIODevice::WriteOnly)) { outError = "Не удалось записать индекс истории"; return false; }
+    QDataStream out(&f);
+    setupStream(out);
+
+    out << INDEX_MAGIC << FORMAT_VERSION << qint64(QFileInfo(logPath()).size()) << qint32(machine);
+    out << qint32(entries.size());
+    for (const auto &v : entries) out << v.offset << v.keyframe << v.date << v.time;
+    out << qint32(regionIndex.size());
+    for (auto it = regionIndex.constBegin(); it != regionIndex.constEnd(); ++it) {
+        out << it.key() << qint32(it.value().size());
+        for (const auto &c : it.value()) out << qint32(c.version) << quint8(c.kind) << c.azimuth << c.elevation;
+    }
+    if (out.status() != QDataStream::Ok || !f.commit()) { outError = "Не удалось записать индекс истории"; return false; }
+    return true;
+}
@@ -0,0 +1,63 @@
+#ifndef CALIBRATIONHISTORY_H
+#define CALIBRATIONHISTORY_H
+
+#include <QString>
+#include <QVector>
+#include <QHash>
+#include <QDate>
+#include <QTime>
+#include "csvhandler.h"
+
+class QDataStream;
+
+// история калибровок одной машины: журнал только на дописывание,
+// каждая версия хранится как дельта к предыдущей, с периодическими ключевыми кадрами.
+// рядом лежит индекс по областям, чтобы отвечать "когда менялось смещение" без декодирования журнала
+class CalibrationHistory {
+public:
+    struct Version {
+        qint64 offset = 0;     // смещение записи в журнале
+        bool keyframe = false;
+        QDate date;
+        QTime time;
+    };
+
+    enum class ChangeKind : quint8 { Added, Changed, Removed };
+
+    struct Change {
+        int version = 0;
+        ChangeKind kind = ChangeKind::Added;
+        double azimuth = 0.0;
+        double elevation = 0.0;
+    };
+
+    explicit CalibrationHistory(const QString &directory, int keyframeInterval = 16);
+
+    bool open(int machineNumber, QString &outError);
+    bool append(const CsvHandler::Result &result, QString &outError);
+
+    int machineNumber() const { return machine; }
+    int versionCount() const { return entries.size(); }
+    const Version &version(int index) const { return entries[index]; }
+
+    bool reconstruct(int version, CsvHandler::Result &outResult, QString &outError) const;
+    QVector<Change> regionChanges(int x1, int y1, int x2, int y2) const;
+
+private:
+    QString logPath() const;
+    QString indexPath() const;
+    bool rebuildIndex(QString &outError);
+    bool loadIndex(qint64 logSize);
+    bool saveIndex(QString &outError) const;
+    void indexChanges(int version, const CsvHandler::Result &prev, const CsvHandler::Result &cur);
+    bool readEntry(QDataStream &in, CsvHandler::Result &state, bool &keyframe, QString &outError) const;
+
+    QString dir;
+    int interval;
+    int machine = -1;
+    QVector<Version> entries;
+    QHash<quint64, QVector<Change>> regionIndex;
+    CsvHandler::Result last; // последняя версия, от неё считается следующая дельта
+};
+
+#endif
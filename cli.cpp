@@ -0,0 +1,329 @@
+#include "cli.h"
+#include "csvhandler.h"
+#include "calibrationhistory.h"
+#include "offsetservice.h"
+#include "offsetcatalog.h"
+#include "occupancymap.h"
+#include "panoramarenderer.h"
+#include <QCoreApplication>
+#include <QTextStream>
+#include <QLoggingCategory>
+#include <QLocalSocket>
+#include <QElapsedTimer>
+#include <QMap>
+#include <QSet>
+#include <QPair>
+#include <QDir>
+#include <QFileInfo>
+#include <QRandomGenerator>
+#include <QtConcurrent>
+#include <algorithm>
+#include <functional>
+#include <QDebug>
+
+namespace {
+
+QTextStream &out() {
+    static QTextStream s(stdout);
+    return s;
+}
+
+QTextStream &err() {
+    static QTextStream s(stderr);
+    return s;
+}
+
+void printUsage() {
+    err() << QString("Использование:\n"
+                     "  --history-add <каталог> <файл.csv>...\n"
+                     "  --history-region <каталог> <машина> <x1> <y1> <x2> <y2>\n"
+                     "  --history-export <каталог> <машина> <версия> <файл.csv>\n"
+                     "  --catalog <каталог> [машина] [файл кэша]\n"
+                     "  --check <файл.csv>...\n"
+                     "  --render <каталог для png> <файл.csv>...\n"
+                     "  --serve <файл.csv> [сокет]\n"
+                     "  --bench-service [сокет] [запросов] [пикселей в запросе] [клиентов]\n");
+    err().flush();
+}
+
+bool toInts(const QStringList &args, int from, int count, QVector<int> &values) {
+    values.clear();
+    for (int i = from; i < from + count; ++i) {
+        bool ok = false;
+        values.append(args.value(i).toInt(&ok));
+        if (!ok) { err() << QString("Не число: ") << args.value(i) << "\n"; return false; }
+    }
+    return true;
+}
+
+int historyAdd(const QStringList &args) {
+    if (args.size() < 4) { printUsage(); return 2; }
+    const QString dir = args[2];
+    CsvHandler handler;
+    int failures = 0;
+    for (int i = 3; i < args.size(); ++i) {
+        CsvHandler::Result res;
+        QString error;
+        if (!handler.load(args[i], res, error)) {
+            err() << args[i] << ": " << error << "\n";
+            ++failures;
+            continue;
+        }
+        CalibrationHistory history(dir);
+        if (!history.open(res.header.machineNumber, error) || !history.append(res, error)) {
+            err() << args[i] << ": " << error << "\n";
+            ++failures;
+            continue;
+        }
+        int v = history.versionCount() - 1;
+        out() << args[i] << QString(": машина %1, версия %2").arg(res.header.machineNumber).arg(v)
+              << QString(history.version(v).keyframe ? " (ключевой кадр)" : " (дельта)") << "\n";
+    }
+    return failures ? 1 : 0;
+}
+
+int historyRegion(const QStringList &args) {
+    QVector<int> v;
+    if (args.size() < 8 || !toInts(args, 3, 5, v)) { printUsage(); return 2; }
+    CalibrationHistory history(args[2]);
+    QString error;
+    if (!history.open(v[0], error)) { err() << error << "\n"; return 1; }
+
+    static const char *kinds[] = {"добавлена", "изменена", "удалена"};
+    for (const auto &c : history.regionChanges(v[1], v[2], v[3], v[4])) {
+        const auto &ver = history.version(c.version);
+        out() << c.version << ";" << ver.date.toString("dd.MM.yyyy") << ";" << ver.time.toString("HH:mm:ss.zzz")
+              << ";" << QString(kinds[static_cast<int>(c.kind)])
+              << ";" << QString::number(c.azimuth, 'f', 2) << ";" << QString::number(c.elevation, 'f', 2) << "\n";
+    }
+    return 0;
+}
+
+int historyExport(const QStringList &args) {
+    QVector<int> v;
+    if (args.size() < 6 || !toInts(args, 3, 2, v)) { printUsage(); return 2; }
+    CalibrationHistory history(args[2]);
+    CsvHandler::Result res;
+    QString error;
+    if (!history.open(v[0], error) || !history.reconstruct(v[1], res, error)
+        || !CsvHandler().save(args[5], res, error)) {
+        err() << error << "\n";
+        return 1;
+    }
+    out() << QString("Версия %1 сохранена: %2").arg(v[1]).arg(args[5]) << "\n";
+    return 0;
+}
+
+int catalog(const QStringList &args) {
+    if (args.size() < 3) { printUsage(); return 2; }
+    const QString dir = args[2];
+    int machine = -1;
+    if (args.size() > 3) {
+        bool ok = false;
+        machine = args[3].toInt(&ok);
+        if (!ok) { printUsage(); return 2; }
+    }
+    OffsetCatalog cat(args.value(4, OffsetCatalog::defaultCacheFile(dir)));
+
+    QElapsedTimer timer;
+    timer.start();
+    cat.load();
+    OffsetCatalog::Stats st = cat.refresh(dir);
+    QString error;
+    if (!cat.save(error)) err() << error << "\n";
+    out() << QString("файлов: %1, перечитано: %2, удалено: %3, за %4 мс\n")
+             .arg(st.total).arg(st.scanned).arg(st.removed).arg(timer.elapsed());
+
+    if (machine >= 0) {
+        const OffsetCatalog::Entry *e = cat.latestFor(machine);
+        if (!e) { err() << QString("Нет таблиц машины %1\n").arg(machine); return 1; }
+        out() << e->path << ";" << e->header.date.toString("dd.MM.yyyy") << ";"
+              << e->header.time.toString("HH:mm:ss.zzz") << ";" << e->count << "\n";
+        return 0;
+    }
+
+    // без номера машины - последняя таблица каждой машины
+    const QMap<int, const OffsetCatalog::Entry*> latest = cat.latestByMachine();
+    for (auto it = latest.constBegin(); it != latest.constEnd(); ++it) {
+        out() << it.key() << ";" << it.value()->path << ";" << it.value()->header.date.toString("dd.MM.yyyy") << ";"
+              << it.value()->header.time.toString("HH:mm:ss.zzz") << ";" << it.value()->count << "\n";
+    }
+    return 0;
+}
+
+// код выхода 1, если хоть в одном файле есть непокрытые области или пересечения
+int check(const QStringList &args) {
+    if (args.size() < 3) { printUsage(); return 2; }
+    CsvHandler handler;
+    int faults = 0;
+    for (int i = 2; i < args.size(); ++i) {
+        CsvHandler::Result res;
+        QString error;
+        if (!handler.load(args[i], res, error)) {
+            err() << args[i] << ": " << error << "\n";
+            ++faults;
+            continue;
+        }
+        OccupancyMap::Report rep = OccupancyMap::check(res.records);
+        if (rep.hasFaults()) ++faults;
+        out() << args[i] << ":\n" << OccupancyMap::describe(rep);
+    }
+    return faults ? 1 : 0;
+}
+
+// картинки рисуются в QImage, поэтому хватает QCoreApplication и дисплей не нужен
+int render(const QStringList &args) {
+    if (args.size() < 4) { printUsage(); return 2; }
+    const QDir outDir(args[2]);
+    if (!QDir().mkpath(outDir.absolutePath())) { err() << QString("Не удалось создать каталог: %1\n").arg(args[2]); return 1; }
+
+    // имена картинок подбираются заранее: одинаковые имена файлов из разных каталогов
+    // получают префикс каталога, а при повторе - номер; один и тот же файл рисуется один раз
+    QVector<QPair<QString, QString>> jobs;
+    QSet<QString> seenFiles, usedNames;
+    for (const QString &file : args.mid(3)) {
+        const QFileInfo info(file);
+        if (seenFiles.contains(info.absoluteFilePath())) continue;
+        seenFiles.insert(info.absoluteFilePath());
+        QString name = info.completeBaseName();
+        if (usedNames.contains(name.toLower())) name = info.absoluteDir().dirName() + "_" + info.completeBaseName();
+        const QString base = name;
+        for (int n = 2; usedNames.contains(name.toLower()); ++n) name = base + "_" + QString::number(n);
+        usedNames.insert(name.toLower());
+        jobs.append(qMakePair(file, outDir.filePath(name + ".png")));
+    }
+
+    auto renderOne = [](const QPair<QString, QString> &job) -> QString {
+        CsvHandler::Result res;
+        QString error;
+        if (!CsvHandler().load(job.first, res, error)) return job.first + ": " + error;
+        if (!PanoramaRenderer::render(res).save(job.second, "PNG")) return job.first + QString(": не удалось записать ") + job.second;
+        return QString();
+    };
+
+    QElapsedTimer timer;
+    timer.start();
+    const QStringList errors = QtConcurrent::blockingMapped<QStringList>(
+        jobs, std::function<QString(const QPair<QString, QString>&)>(renderOne));
+    const double seconds = timer.nsecsElapsed() / 1e9;
+
+    int failed = 0;
+    for (const QString &e : errors) {
+        if (e.isEmpty()) continue;
+        err() << e << "\n";
+        ++failed;
+    }
+    const int done = jobs.size() - failed;
+    out() << QString("картинок: %1, ошибок: %2, за %3 с, %4 картинок/с\n")
+             .arg(done).arg(failed).arg(seconds, 0, 'f', 2).arg(seconds > 0 ? done / seconds : 0.0, 0, 'f', 1);
+    return failed ? 1 : 0;
+}
+
+const char *DEFAULT_SOCKET = "panorama-offsets";
+
+int serve(const QStringList &args) {
+    if (args.size() < 3) { printUsage(); return 2; }
+    OffsetService service(args[2]);
+    QString error;
+    if (!service.start(args.value(3, DEFAULT_SOCKET), error)) { err() << error << "\n"; return 1; }
+    out() << QString("Сервис смещений запущен: %1\n").arg(args.value(3, DEFAULT_SOCKET));
+    out().flush();
+    return QCoreApplication::exec();
+}
+
+// один клиент нагрузки: блокирующий сокет, задержка каждого запроса в микросекундах
+QVector<double> benchClient(const QString &socketName, int requests, int batch) {
+    QVector<double> latencies;
+    QLocalSocket socket;
+    socket.connectToServer(socketName);
+    if (!socket.waitForConnected(3000)) return latencies;
+
+    latencies.reserve(requests);
+    QRandomGenerator *rng = QRandomGenerator::global();
+    QElapsedTimer timer;
+    for (int i = 0; i < requests; ++i) {
+        QByteArray line = batch == 1 ? QByteArray("px") : QByteArray("pxs");
+        for (int j = 0; j < batch; ++j) {
+            line += ';' + QByteArray::number(rng->bounded(3840));
+            line += (batch == 1 ? ';' : ',') + QByteArray::number(rng->bounded(512));
+        }
+        line += '\n';
+
+        timer.start();
+        socket.write(line);
+        socket.waitForBytesWritten(3000);
+        while (!socket.canReadLine()) {
+            if (!socket.waitForReadyRead(3000)) return latencies;
+        }
+        socket.readLine();
+        latencies.append(timer.nsecsElapsed() / 1000.0);
+    }
+    socket.disconnectFromServer();
+    return latencies;
+}
+
+int benchService(const QStringList &args) {
+    const QString socketName = args.value(2, DEFAULT_SOCKET);
+    const int requests = qMax(1, args.value(3, "10000").toInt());
+    const int batch = qMax(1, args.value(4, "1").toInt());
+    const int clients = qMax(1, args.value(5, "1").toInt());
+
+    QElapsedTimer total;
+    total.start();
+    QVector<QFuture<QVector<double>>> runs;
+    for (int c = 0; c < clients; ++c) runs.append(QtConcurrent::run(benchClient, socketName, requests, batch));
+    QVector<double> all;
+    for (auto &f : runs) all += f.result();
+    double seconds = total.nsecsElapsed() / 1e9;
+
+    if (all.isEmpty()) { err() << QString("Нет ответа от сервиса: %1\n").arg(socketName); return 1; }
+    std::sort(all.begin(), all.end());
+    auto pct = [&all](double p) { return all[qMin(int(all.size()) - 1, int(p * all.size()))]; };
+    out() << QString("запросов: %1, пикселей в запросе: %2, клиентов: %3\n").arg(all.size()).arg(batch).arg(clients)
+          << QString("p50: %1 мкс, p99: %2 мкс, макс: %3 мкс\n").arg(pct(0.50), 0, 'f', 1).arg(pct(0.99), 0, 'f', 1).arg(all.last(), 0, 'f', 1)
+          << QString("пикселей в секунду: %1\n").arg(all.size() * double(batch) / seconds, 0, 'f', 0);
+    return 0;
+}
+
+}
+
+namespace Cli {
+
+bool isCommand(int argc, char *argv[]) {
+    // остальные аргументы (--platform, --style, --reverse ...) - опции Qt для окна
+    static const char *const commands[] = {
+        "--history-add", "--history-region", "--history-export", "--catalog",
+        "--check", "--render", "--serve", "--bench-service"
+    };
+    if (argc < 2) return false;
+    for (const char *c : commands) {
+        if (qstrcmp(argv[1], c) == 0) return true;
+    }
+    return false;
+}
+
+int run(const QStringList &args) {
+#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
+    out().setEncoding(QStringConverter::Utf8);
+    err().setEncoding(QStringConverter::Utf8);
+#endif
+    // подробный лог разбора в консольных режимах не нужен
+    QLoggingCategory::setFilterRules("default.debug=false");
+
+    const QString cmd = args.value(1);
+    int code = 2;
+    if (cmd == "--history-add") code = historyAdd(args);
+    else if (cmd == "--history-region") code = historyRegion(args);
+    else if (cmd == "--history-export") code = historyExport(args);
+    else if (cmd == "--catalog") code = catalog(args);
+    else if (cmd == "--check") code = check(args);
+    else if (cmd == "--render") code = render(args);
+    else if (cmd == "--serve") code = serve(args);
+    else if (cmd == "--bench-service") code = benchService(args);
+    else printUsage();
+    out().flush();
+    err().flush();
+    return code;
+}
+
+}
@@ -0,0 +1,15 @@
+#ifndef CLI_H
+#define CLI_H
+
+#include <QStringList>
+
+// консольные режимы без главного окна, первым аргументом идёт команда вида --имя
+namespace Cli {
+
+// true только для известных команд, прочие аргументы остаются QApplication
+bool isCommand(int argc, char *argv[]);
+int run(const QStringList &args);
+
+}
+
+#endif
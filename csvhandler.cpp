@@ -41,119 +41,168 @@ bool CsvHandler::validateRecord(const Record &rec, QString &outError, int maxWid
     return true;
 }
 
-bool CsvHandler::load(const QString &filename, Result &outResult, QString &outError) const {
-    qDebug() << "CSV загружается:" << filename;
-    outResult = Result{};
-    QFile f(filename);
-    if (!f.open(QIODevice::ReadOnly | QIODevice::Text)) { outError = "Не удалось открыть файл"; return false; }
-    QTextStream in(&f);
-#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
-    in.setEncoding(QStringConverter::Utf8);
-#endif
+void CsvHandler::Parser::reset() {
+    *this = Parser{};
+}
 
-    bool seenHeader = false;
-    bool seenVersion = false;
-    bool seenCount = false;
-    bool inData = false;
-    int declaredCount = -1;
-    int lineNo = 0;
-
-    while (!in.atEnd()) {
-        QString raw = in.readLine();
-        ++lineNo;
-        QString line = raw.trimmed();
-        if (line.isEmpty()) continue;
-        QStringList parts = line.split(';');
-        QString key = parts.value(0).trimmed().toLower();
-
-        if (inData) {
-
-            if (parts.size() < 6) { qDebug() << "CSV ошибка: недостаточно полей в ряду" << lineNo; outError = QString("Строка %1: недостаточно полей").arg(lineNo); return false; }
-            Record r;
-            QString err;
-            if (!parseInt(parts[0], r.x1, err, "XНач")) { qDebug() << "CSV ошибка:" << err << "line" << lineNo; outError = QString("Строка %1: %2").arg(lineNo).arg(err); return false; }
-            if (!parseInt(parts[1], r.y1, err, "YНач")) { qDebug() << "CSV ошибка:" << err << "line" << lineNo; outError = QString("Строка %1: %2").arg(lineNo).arg(err); return false; }
-            if (!parseInt(parts[2], r.x2, err, "XКон")) { qDebug() << "CSV ошибка:" << err << "line" << lineNo; outError = QString("Строка %1: %2").arg(lineNo).arg(err); return false; }
-            if (!parseInt(parts[3], r.y2, err, "YКон")) { qDebug() << "CSV ошибка:" << err << "line" << lineNo; outError = QString("Строка %1: %2").arg(lineNo).arg(err); return false; }
-            if (!parseDoublePoint(parts[4], r.azimuth, err, "Азимут")) { qDebug() << "CSV error:" << err << "line" << lineNo; outError = QString("Строка %1: %2").arg(lineNo).arg(err); return false; }
-            if (!parseDoublePoint(parts[5], r.elevation, err, "Угол")) { qDebug() << "CSV error:" << err << "line" << lineNo; outError = QString("Строка %1: %2").arg(lineNo).arg(err); return false; }
-
-            if (r.x1 > r.x2) { int temp = r.x1; r.x1 = r.x2; r.x2 = temp; }
-            if (r.y1 > r.y2) { int temp = r.y1; r.y1 = r.y2; r.y2 = temp; }
-
-            if (r.x1 < 0 || r.x2 >= 3840 || r.y1 < 0 || r.y2 >= 512) {
-                qDebug() << "CSV ошибка: за границами" << lineNo << ":" << r.x1 << r.y1 << r.x2 << r.y2;
-                outError = QString("Строка %1: координаты вне диапазона [0,3840)x[0,512)").arg(lineNo);
-                return false;
-            }
-
-            outResult.records.push_back(r);
-            qDebug() << "CSV ряд добавлен:" << r.x1 << r.y1 << r.x2 << r.y2 << r.azimuth << r.elevation;
-            continue;
+bool CsvHandler::Parser::feed(const QByteArray &chunk, Result &result, QString &outError) {
+    pending.append(chunk);
+    int start = 0;
+    int nl;
+    while ((nl = pending.indexOf('\n', start)) >= 0) {
+        QByteArray line = pending.mid(start, nl - start);
+        start = nl + 1;
+        if (!parseLine(QString::fromUtf8(line), result, outError)) {
+            pending.remove(0, start);
+            return false;
         }
+    }
+    pending.remove(0, start);
+    return true;
+}
 
-        if (key == "text") {
-            outResult.header.commentTextLines << parts.mid(1).join(';');
-            continue;
-        }
-        if (key == "header") {
-            if (parts.size() < 4) { outError = QString("Строка %1: некорректный header").arg(lineNo); return false; }
-            seenHeader = true;
-            QString err;
-            if (!parseInt(parts[1], outResult.header.machineNumber, err, "НомерМашины")) { outError = QString("Строка %1: %2").arg(lineNo).arg(err); return false; }
-            outResult.header.date = QDate::fromString(parts[2], "dd.MM.yyyy");
-            outResult.header.time = QTime::fromString(parts[3], "HH:mm:ss.zzz");
-            if (!outResult.header.date.isValid() || !outResult.header.time.isValid()) {
-                outError = QString("Строка %1: некорректные дата/время в header").arg(lineNo);
-                return false;
-            }
-            qDebug() << "CSV заголовок:" << outResult.header.machineNumber << outResult.header.date << outResult.header.time;
-            continue;
-        }
-        if (key == "version") {
-            if (parts.size() < 2) { outError = QString("Строка %1: некорректный version").arg(lineNo); return false; }
-            bool ok=false; int ver = parts[1].toInt(&ok);
-            if (!ok) { outError = QString("Строка %1: version не число").arg(lineNo); return false; }
-            outResult.header.version = ver;
-            seenVersion = true;
-            qDebug() << "CSV версия:" << ver;
-            continue;
-        }
-        if (key == "count") {
-            if (parts.size() < 2) { outError = QString("Строка %1: некорректный count").arg(lineNo); return false; }
-            bool ok=false; declaredCount = parts[1].toInt(&ok);
-            if (!ok || declaredCount < 0) { outError = QString("Строка %1: count не число").arg(lineNo); return false; }
-            seenCount = true;
-            qDebug() << "CSV колво рядов:" << declaredCount;
-            continue;
+bool CsvHandler::Parser::parseLine(const QString &raw, Result &outResult, QString &outError) {
+    ++lineNo;
+    QString line = raw.trimmed();
+    if (lineNo == 1 && line.startsWith(QChar(0xFEFF))) line = line.mid(1).trimmed(); // BOM
+    if (line.isEmpty()) return true;
+    QStringList parts = line.split(';');
+    QString key = parts.value(0).trimmed().toLower();
+
+    if (inDataSection) {
+
+        if (parts.size() < 6) { qDebug() << "CSV ошибка: недостаточно полей в ряду" << lineNo; outError = QString("Строка %1: недостаточно полей").arg(lineNo); return false; }
+        Record r;
+        QString err;
+        if (!parseInt(parts[0], r.x1, err, "XНач")) { qDebug() << "CSV ошибка:" << err << "line" << lineNo; outError = QString("Строка %1: %2").arg(lineNo).arg(err); return false; }
+        if (!parseInt(parts[1], r.y1, err, "YНач")) { qDebug() << "CSV ошибка:" << err << "line" << lineNo; outError = QString("Строка %1: %2").arg(lineNo).arg(err); return false; }
+        if (!parseInt(parts[2], r.x2, err, "XКон")) { qDebug() << "CSV ошибка:" << err << "line" << lineNo; outError = QString("Строка %1: %2").arg(lineNo).arg(err); return false; }
+        if (!parseInt(parts[3], r.y2, err, "YКон")) { qDebug() << "CSV ошибка:" << err << "line" << lineNo; outError = QString("Строка %1: %2").arg(lineNo).arg(err); return false; }
+        if (!parseDoublePoint(parts[4], r.azimuth, err, "Азимут")) { qDebug() << "CSV error:" << err << "line" << lineNo; outError = QString("Строка %1: %2").arg(lineNo).arg(err); return false; }
+        if (!parseDoublePoint(parts[5], r.elevation, err, "Угол")) { qDebug() << "CSV error:" << err << "line" << lineNo; outError = QString("Строка %1: %2").arg(lineNo).arg(err); return false; }
+
+        if (r.x1 > r.x2) { int temp = r.x1; r.x1 = r.x2; r.x2 = temp; }
+        if (r.y1 > r.y2) { int temp = r.y1; r.y1 = r.y2; r.y2 = temp; }
+
+        if (r.x1 < 0 || r.x2 >= 3840 || r.y1 < 0 || r.y2 >= 512) {
+            qDebug() << "CSV ошибка: за границами" << lineNo << ":" << r.x1 << r.y1 << r.x2 << r.y2;
+            outError = QString("Строка %1: координаты вне диапазона [0,3840)x[0,512)").arg(lineNo);
+            return false;
         }
-        if (key == "data") {
-            inData = true;
-            qDebug() << "CSV данные начинаются со строки" << lineNo;
-            continue;
+
+        outResult.records.push_back(r);
+        qDebug() << "CSV ряд добавлен:" << r.x1 << r.y1 << r.x2 << r.y2 << r.azimuth << r.elevation;
+        return true;
+    }
+
+    if (key == "text") {
+        outResult.header.commentTextLines << parts.mid(1).join(';');
+        return true;
+    }
+    if (key == "header") {
+        if (parts.size() < 4) { outError = QString("Строка %1: некорректный header").arg(lineNo); return false; }
+        seenHeader = true;
+        QString err;
+        if (!parseInt(parts[1], outResult.header.machineNumber, err, "НомерМашины")) { outError = QString("Строка %1: %2").arg(lineNo).arg(err); return false; }
+        outResult.header.date = QDate::fromString(parts[2], "dd.MM.yyyy");
+        outResult.header.time = QTime::fromString(parts[3], "HH:mm:ss.zzz");
+        if (!outResult.header.date.isValid() || !outResult.header.time.isValid()) {
+            outError = QString("Строка %1: некорректные дата/время в header").arg(lineNo);
+            return false;
         }
+        qDebug() << "CSV заголовок:" << outResult.header.machineNumber << outResult.header.date << outResult.header.time;
+        return true;
+    }
+    if (key == "version") {
+        if (parts.size() < 2) { outError = QString("Строка %1: некорректный version").arg(lineNo); return false; }
+        bool ok=false; int ver = parts[1].toInt(&ok);
+        if (!ok) { outError = QString("Строка %1: version не число").arg(lineNo); return false; }
+        outResult.header.version = ver;
+        seenVersion = true;
+        qDebug() << "CSV версия:" << ver;
+        return true;
+    }
+    if (key == "count") {
+        if (parts.size() < 2) { outError = QString("Строка %1: некорректный count").arg(lineNo); return false; }
+        bool ok=false; declared = parts[1].toInt(&ok);
+        if (!ok || declared < 0) { outError = QString("Строка %1: count не число").arg(lineNo); return false; }
+        seenCount = true;
+        qDebug() << "CSV колво рядов:" << declared;
+        return true;
+    }
+    if (key == "data") {
+        inDataSection = true;
+        qDebug() << "CSV данные начинаются со строки" << lineNo;
+        return true;
+    }
+    return true;
+}
+
+// версия протокола: поддерживаем 1
+static bool checkVersion(int version, QString &outError) {
+    if (version != 1) {
+        outError = QString("Неподдерживаемая версия протокола: %1. Программа поддерживает только версию 1.").arg(version);
+        return false;
+    }
+    return true;
+}
+
+bool CsvHandler::Parser::finish(Result &outResult, QString &outError) {
+    if (!pending.isEmpty()) {
+        QByteArray last = pending;
+        pending.clear();
+        if (!parseLine(QString::fromUtf8(last), outResult, outError)) return false;
     }
 
     if (!seenHeader) { outError = "Отсутствует секция header"; return false; }
     if (!seenVersion) { outError = "Отсутствует секция version"; return false; }
     if (!seenCount) { outError = "Отсутствует секция count"; return false; }
-    if (declaredCount != outResult.records.size()) {
-        qDebug() << "CSV не совпадает колво рядов:" << declaredCount << "/" << outResult.records.size();
+    if (declared != outResult.records.size()) {
+        qDebug() << "CSV не совпадает колво рядов:" << declared << "/" << outResult.records.size();
         outError = QString("Несоответствие count (%1) и числа записей (%2)")
-                   .arg(declaredCount).arg(outResult.records.size());
+                   .arg(declared).arg(outResult.records.size());
         return false;
     }
 
-    // версия протокола: поддерживаем 1
-    if (outResult.header.version != 1) {
-        outError = QString("Неподдерживаемая версия протокола: %1. Программа поддерживает только версию 1.").arg(outResult.header.version);
-        return false;
-    }
+    return checkVersion(outResult.header.version, outError);
+}
+
+bool CsvHandler::load(const QString &filename, Result &outResult, QString &outError) const {
+    qDebug() << "CSV загружается:" << filename;
+    outResult = Result{};
+    QFile f(filename);
+    if (!f.open(QIODevice::ReadOnly | QIODevice::Text)) { outError = "Не удалось открыть файл"; return false; }
+
+    Parser parser;
+    if (!parser.feed(f.readAll(), outResult, outError)) return false;
+    if (!parser.finish(outResult, outError)) return false;
 
     qDebug() << "CSV успешно загружено, рядов:" << outResult.records.size();
     return true;
 }
 
+bool CsvHandler::loadHeader(const QString &filename, Header &outHeader, int &outCount, QString &outError) const {
+    outHeader = Header{};
+    outCount = -1;
+    QFile f(filename);
+    if (!f.open(QIODevice::ReadOnly | QIODevice::Text)) { outError = "Не удалось открыть файл"; return false; }
+
+    Parser parser;
+    Result res;
+    while (!parser.inData() && !f.atEnd()) {
+        if (!parser.parseLine(QString::fromUtf8(f.readLine()), res, outError)) return false;
+    }
+
+    if (!parser.hasHeader()) { outError = "Отсутствует секция header"; return false; }
+    if (!parser.hasVersion()) { outError = "Отсутствует секция version"; return false; }
+    if (!parser.hasCount()) { outError = "Отсутствует секция count"; return false; }
+    // каталог должен отвергать те же файлы, что и load
+    if (!checkVersion(res.header.version, outError)) return false;
+    outHeader = res.header;
+    outCount = parser.declaredCount();
+    return true;
+}
+
 bool CsvHandler::save(const QString &filename, const Result &inResult, QString &outError) const {
     qDebug() << "CSV сохранение началось:" << filename << "рядов:" << inResult.records.size();
     QFile f(filename);
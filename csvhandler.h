@@ -2,6 +2,7 @@
 #define CSVHANDLER_H
 
 #include <QString>
+#include <QByteArray>
 #include <QStringList>
 #include <QVector>
 #include <QDate>
@@ -35,10 +36,41 @@ public:
         QVector<Record> records;
     };
 
+    // построчный разбор с сохранением состояния между порциями данных,
+    // позволяет дочитывать файл, который ещё дописывается
+    class Parser {
+    public:
+        void reset();
+        // разбирает только целые строки, хвост без '\n' ждёт следующей порции
+        bool feed(const QByteArray &chunk, Result &result, QString &outError);
+        bool parseLine(const QString &raw, Result &result, QString &outError);
+        // дочитывает хвост и проверяет обязательные секции и count
+        bool finish(Result &result, QString &outError);
+
+        bool inData() const { return inDataSection; }
+        bool hasHeader() const { return seenHeader; }
+        bool hasVersion() const { return seenVersion; }
+        bool hasCount() const { return seenCount; }
+        int declaredCount() const { return declared; }
+        int lineNumber() const { return lineNo; }
+
+    private:
+        bool seenHeader = false;
+        bool seenVersion = false;
+        bool seenCount = false;
+        bool inDataSection = false;
+        int declared = -1;
+        int lineNo = 0;
+        QByteArray pending;
+    };
+
     CsvHandler();
 
     bool load(const QString &filename, Result &outResult, QString &outError) const;
 
+    // только шапка text/header/version/count, чтение останавливается на data
+    bool loadHeader(const QString &filename, Header &outHeader, int &outCount, QString &outError) const;
+
 
     bool save(const QString &filename, const Result &inResult, QString &outError) const;
 
@@ -0,0 +1,99 @@
+#include "filefollower.h"
+#include <QFile>
+#include <QFileInfo>
+#include <QFileSystemWatcher>
+#include <QTimer>
+#include <QDebug>
+
+static const qint64 HEAD_BYTES = 256;
+static const int POLL_INTERVAL_MS = 1000;
+
+FileFollower::FileFollower(QObject *parent)
+    : QObject(parent)
+    , watcher(new QFileSystemWatcher(this))
+    , pollTimer(new QTimer(this))
+{
+    pollTimer->setInterval(POLL_INTERVAL_MS);
+    connect(watcher, &QFileSystemWatcher::fileChanged, this, &FileFollower::onFileChanged);
+    connect(pollTimer, &QTimer::timeout, this, &FileFollower::onFileChanged);
+}
+
+bool FileFollower::start(const QString &filename, QString &outError) {
+    stop();
+    path = filename;
+    if (!reload(outError)) return false;
+    watcher->addPath(path);
+    pollTimer->start();
+    qDebug() << "слежение за файлом:" << path;
+    return true;
+}
+
+void FileFollower::stop() {
+    if (!watcher->files().isEmpty()) watcher->removePaths(watcher->files());
+    pollTimer->stop();
+    path.clear();
+    offset = 0;
+    head.clear();
+    parser.reset();
+    res = CsvHandler::Result{};
+}
+
+void FileFollower::onFileChanged() {
+    if (path.isEmpty()) return;
+    // при перезаписи через переименование наблюдатель теряет файл
+    if (!watcher->files().contains(path) && QFileInfo::exists(path)) watcher->addPath(path);
+
+    QString error;
+    if (!readTail(error)) emit failed(error);
+}
+
+bool FileFollower::reload(QString &outError) {
+    offset = 0;
+    head.clear();
+    parser.reset();
+    res = CsvHandler::Result{};
+    QFile f(path);
+    if (!f.open(QIODevice::ReadOnly)) {
+        outError = "Не удалось открыть файл";
+        stop();
+        return false;
+    }
+    QByteArray data = f.readAll();
+    offset = data.size();
+    head = data.left(HEAD_BYTES);
+    if (!parser.feed(data, res, outError)) {
+        // наполовину разобранный файл не отдаём: слежение прекращается, таблица остаётся прежней
+        qDebug() << "ошибка перезагрузки, слежение остановлено:" << outError;
+        stop();
+        return false;
+    }
+    emit reloaded();
+    return true;
+}
+
+bool FileFollower::readTail(QString &outError) {
+    QFile f(path);
+    if (!f.open(QIODevice::ReadOnly)) { outError = "Не удалось открыть файл"; return false; }
+
+    // усечение или перезапись: начало файла уже не то, что мы разбирали
+    if (f.size() < offset || f.read(head.size()) != head) {
+        qDebug() << "файл перезаписан, полная перезагрузка:" << path;
+        return reload(outError);
+    }
+    if (f.size() == offset) return true;
+
+    if (!f.seek(offset)) { outError = "Не удалось перейти к концу файла"; return false; }
+    QByteArray chunk = f.readAll();
+    offset += chunk.size();
+    if (head.size() < HEAD_BYTES) {
+        f.seek(0);
+        head = f.read(HEAD_BYTES);
+    }
+
+    int first = res.records.size();
+    bool ok = parser.feed(chunk, res, outError);
+    int added = res.records.size() - first;
+    if (added > 0) emit recordsAppended(first, added);
+    qDebug() << "дочитано байт:" << chunk.size() << "новых рядов:" << added;
+    return ok;
+}
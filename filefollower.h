@@ -0,0 +1,48 @@
+#ifndef FILEFOLLOWER_H
+#define FILEFOLLOWER_H
+
+#include <QObject>
+#include <QString>
+#include <QByteArray>
+#include "csvhandler.h"
+
+class QFileSystemWatcher;
+class QTimer;
+
+// слежение за дописываемым файлом смещений: читаются только новые байты,
+// состояние парсера сохраняется между чтениями
+class FileFollower : public QObject {
+    Q_OBJECT
+
+public:
+    explicit FileFollower(QObject *parent = nullptr);
+
+    bool start(const QString &filename, QString &outError);
+    void stop();
+
+    bool isActive() const { return !path.isEmpty(); }
+    QString fileName() const { return path; }
+    const CsvHandler::Result &result() const { return res; }
+
+signals:
+    void reloaded();                          // файл перечитан целиком
+    void recordsAppended(int first, int count); // дописаны записи [first, first+count)
+    void failed(const QString &error);       // при ошибке перезагрузки слежение уже остановлено
+
+private slots:
+    void onFileChanged();
+
+private:
+    bool reload(QString &outError);
+    bool readTail(QString &outError);
+
+    QFileSystemWatcher *watcher;
+    QTimer *pollTimer; // запасной опрос, если уведомление потерялось
+    QString path;
+    qint64 offset = 0;   // сколько байт уже разобрано
+    QByteArray head;     // начало файла, по нему узнаём перезапись
+    CsvHandler::Parser parser;
+    CsvHandler::Result res;
+};
+
+#endif
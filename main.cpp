@@ -1,7 +1,15 @@
 #include <QApplication>
+#include <QCoreApplication>
 #include "mainwindow.h"
+#include "cli.h"
 
 int main(int argc, char *argv[]) {
+    // консольные режимы без окна
+    if (Cli::isCommand(argc, argv)) {
+        QCoreApplication app(argc, argv);
+        return Cli::run(app.arguments());
+    }
+
     QApplication app(argc, argv);
 
     MainWindow w;
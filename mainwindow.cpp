@@ -1,6 +1,7 @@
 #include "mainwindow.h"
 #include "ui_mainwindow.h"
 #include "csvhandler.h"
+#include "occupancymap.h"
 #include <QFileDialog>
 #include <QGraphicsRectItem>
 #include <QGraphicsLineItem>
@@ -9,6 +10,15 @@
 #include <QGraphicsSceneMouseEvent>
 #include <QBrush>
 #include <QDateTime>
+#include <QItemSelection>
+#include <QSignalBlocker>
+#include <QStatusBar>
+#include <QShortcut>
+#include <QClipboard>
+#include <QGuiApplication>
+#include <QInputDialog>
+#include <QRegularExpression>
+#include <QtConcurrent>
 
 static const int ROW_ROLE = 1;
 
@@ -44,6 +54,27 @@ MainWindow::MainWindow(QWidget *parent)
     connect(ui->btnSave, &QPushButton::clicked, this, &MainWindow::saveFile);
     connect(ui->btnAddRow, &QPushButton::clicked, this, &MainWindow::addRow);
     connect(ui->btnRemoveRow, &QPushButton::clicked, this, &MainWindow::removeRow);
+    connect(ui->btnFollow, &QPushButton::toggled, this, &MainWindow::toggleFollow);
+    connect(ui->btnShiftOffsets, &QPushButton::clicked, this, &MainWindow::shiftOffsets);
+    connect(ui->btnScaleOffsets, &QPushButton::clicked, this, &MainWindow::scaleOffsets);
+    connect(ui->btnMoveRegions, &QPushButton::clicked, this, &MainWindow::moveRegions);
+    connect(new QShortcut(QKeySequence::Paste, table), &QShortcut::activated, this, &MainWindow::pasteRows);
+
+    // отложенная перерисовка: сколько бы правок ни пришло, рисуем один раз
+    redrawTimer = new QTimer(this);
+    redrawTimer->setSingleShot(true);
+    redrawTimer->setInterval(0);
+    connect(redrawTimer, &QTimer::timeout, this, &MainWindow::drawRectangles);
+
+    // геометрия считается в пуле потоков, сюда приходит только готовый результат
+    geometryWatcher = new QFutureWatcher<PanoramaGeometry::Frame>(this);
+    connect(geometryWatcher, &QFutureWatcher<PanoramaGeometry::Frame>::finished, this, &MainWindow::onGeometryReady);
+
+    // слежение за файлом
+    follower = new FileFollower(this);
+    connect(follower, &FileFollower::reloaded, this, &MainWindow::onFollowReloaded);
+    connect(follower, &FileFollower::recordsAppended, this, &MainWindow::onFollowAppended);
+    connect(follower, &FileFollower::failed, this, &MainWindow::onFollowFailed);
 
     connect(table->selectionModel(), &QItemSelectionModel::selectionChanged,
             this, &MainWindow::onTableSelectionChanged);
@@ -73,34 +104,148 @@ void MainWindow::loadFile() {
         return;
     }
 
+    if (follower->isActive()) ui->btnFollow->setChecked(false);
+    currentFileName = fileName;
+    fillTable(res);
+    hasUnsavedEdits = false;
+
+    scheduleRedraw();
+    QMessageBox::information(this, "Загрузка", "Файл загружен: " + fileName);
+}
+
+void MainWindow::fillTable(const CsvHandler::Result &res) {
     table->blockSignals(true);
     table->clearContents();
     table->setRowCount(0);
-    for (int i=0; i<res.records.size(); ++i) {
-        const auto &r = res.records[i];
-        int row = table->rowCount();
-        table->insertRow(row);
-        {
-            auto *it = new QTableWidgetItem(QString::number(row+1));
-            it->setFlags(it->flags() & ~Qt::ItemIsEditable);
-            table->setItem(row, 0, it);
-        }
-        table->setItem(row, 1, new QTableWidgetItem(QString::number(r.x1)));
-        table->setItem(row, 2, new QTableWidgetItem(QString::number(r.y1)));
-        table->setItem(row, 3, new QTableWidgetItem(QString::number(r.x2)));
-        table->setItem(row, 4, new QTableWidgetItem(QString::number(r.y2)));
-        table->setItem(row, 5, new QTableWidgetItem(QString::number(r.azimuth, 'f', 2)));
-        table->setItem(row, 6, new QTableWidgetItem(QString::number(r.elevation, 'f', 2)));
-    }
+    for (const auto &r : res.records) appendTableRow(r);
     table->blockSignals(false);
 
     // поля header
     ui->lineMachine->setText(QString::number(res.header.machineNumber));
     if (ui->lineDate) ui->lineDate->setText(res.header.date.toString("dd.MM.yyyy"));
     if (ui->lineTime) ui->lineTime->setText(res.header.time.toString("HH:mm:ss.zzz"));
+}
 
-    drawRectangles();
-    QMessageBox::information(this, "Загрузка", "Файл загружен: " + fileName);
+void MainWindow::appendTableRow(const CsvHandler::Record &r) {
+    int row = table->rowCount();
+    table->insertRow(row);
+    {
+        auto *it = new QTableWidgetItem(QString::number(row+1));
+        it->setFlags(it->flags() & ~Qt::ItemIsEditable);
+        table->setItem(row, 0, it);
+    }
+    table->setItem(row, 1, new QTableWidgetItem(QString::number(r.x1)));
+    table->setItem(row, 2, new QTableWidgetItem(QString::number(r.y1)));
+    table->setItem(row, 3, new QTableWidgetItem(QString::number(r.x2)));
+    table->setItem(row, 4, new QTableWidgetItem(QString::number(r.y2)));
+    table->setItem(row, 5, new QTableWidgetItem(QString::number(r.azimuth, 'f', 2)));
+    table->setItem(row, 6, new QTableWidgetItem(QString::number(r.elevation, 'f', 2)));
+    ++editChanges;
+}
+
+bool MainWindow::confirmDiscardEdits() {
+    if (!hasUnsavedEdits) return true;
+    return QMessageBox::question(this, "Несохранённые правки",
+                                 "В таблице есть несохранённые правки, данные файла их заменят. Продолжить?")
+           == QMessageBox::Yes;
+}
+
+void MainWindow::toggleFollow(bool enabled) {
+    if (!enabled) {
+        follower->stop();
+        return;
+    }
+    QString fileName = currentFileName;
+    if (fileName.isEmpty()) {
+        fileName = QFileDialog::getOpenFileName(this, "Следить за CSV", "", "CSV Files (*.csv);;All Files (*.*)");
+    }
+    if (fileName.isEmpty() || !confirmDiscardEdits()) {
+        ui->btnFollow->setChecked(false);
+        return;
+    }
+    // согласие уже получено, первая загрузка в onFollowReloaded не переспрашивает
+    const bool hadEdits = hasUnsavedEdits;
+    hasUnsavedEdits = false;
+    QString error;
+    if (!follower->start(fileName, error)) {
+        hasUnsavedEdits = hadEdits;
+        ui->btnFollow->setChecked(false);
+        QMessageBox::critical(this, "Ошибка слежения", error);
+        return;
+    }
+    currentFileName = fileName;
+}
+
+void MainWindow::onFollowReloaded() {
+    // файл перезаписан, пока в таблице были правки
+    if (!confirmDiscardEdits()) {
+        ui->btnFollow->setChecked(false);
+        statusBar()->showMessage("Слежение остановлено: правки в таблице сохранены", 5000);
+        return;
+    }
+    CsvHandler::Result res = follower->result();
+    QString error;
+    CsvHandler::autoFixResult(res, error);
+    fillTable(res);
+    hasUnsavedEdits = false;
+    scheduleRedraw();
+}
+
+void MainWindow::onFollowAppended(int first, int count) {
+    CsvHandler::Result added;
+    added.records = follower->result().records.mid(first, count);
+    QString error;
+    CsvHandler::autoFixResult(added, error);
+
+    const int firstRow = table->rowCount();
+    table->blockSignals(true);
+    for (const auto &r : added.records) appendTableRow(r);
+    table->blockSignals(false);
+
+    // сцена отстаёт от таблицы (идёт пересчёт или он запрошен) - новые ряды попадут в него
+    if (currentFrame.generation != geometryGeneration) {
+        scheduleRedraw();
+        return;
+    }
+
+    // дорисовываем только новые ряды: стоимость зависит от дописанного, а не от размера файла
+    QVector<PanoramaGeometry::Input> inputs = PanoramaGeometry::fromRecords(added.records);
+    for (auto &in : inputs) in.row += firstRow;
+    const int firstShape = currentFrame.shapes.size();
+    const int firstIntersection = currentFrame.intersections.size();
+    const QVector<int> newlyIntersecting = PanoramaGeometry::append(currentFrame, inputs);
+
+    isRedrawing = true;
+    table->blockSignals(true);
+    rowItems.resize(table->rowCount());
+    for (int i = firstShape; i < currentFrame.shapes.size(); ++i) {
+        const PanoramaGeometry::Shape &shape = currentFrame.shapes[i];
+        const bool red = currentFrame.intersectRows.contains(shape.row);
+        addShapeItem(shape, red);
+        paintTableRow(shape.row, red);
+    }
+    // старые ряды, которые задели новые записи
+    for (int row : newlyIntersecting) {
+        if (row >= firstRow) continue;
+        for (QGraphicsItem *item : rowItems.value(row)) setItemPen(item, QPen(Qt::red, 2));
+        paintTableRow(row, true);
+    }
+    for (int i = firstIntersection; i < currentFrame.intersections.size(); ++i) {
+        addIntersectionItem(currentFrame.intersections[i]);
+    }
+    table->blockSignals(false);
+    isRedrawing = false;
+}
+
+void MainWindow::onFollowFailed(const QString &error) {
+    qDebug() << "ошибка слежения:" << error;
+    if (!follower->isActive()) {
+        // перечитать файл не удалось, follower остановлен и сброшен
+        ui->btnFollow->setChecked(false);
+        QMessageBox::warning(this, "Слежение остановлено", error);
+        return;
+    }
+    statusBar()->showMessage("Ошибка слежения: " + error, 5000);
 }
 
 void MainWindow::saveFile() {
@@ -135,12 +280,22 @@ void MainWindow::saveFile() {
         res.records.push_back(rec);
     }
 
+    // покрытие и пересечения областей по битовой карте
+    OccupancyMap::Report occupancy = OccupancyMap::check(res.records);
+    if (occupancy.hasFaults()) {
+        auto answer = QMessageBox::question(this, "Проверка покрытия",
+                                            OccupancyMap::describe(occupancy) + "\nСохранить всё равно?",
+                                            QMessageBox::Save | QMessageBox::Cancel, QMessageBox::Cancel);
+        if (answer != QMessageBox::Save) return;
+    }
+
     CsvHandler handler;
     QString error;
     if (!handler.save(fileName, res, error)) {
         QMessageBox::critical(this, "Ошибка сохранения", error);
         return;
     }
+    hasUnsavedEdits = false;
     QMessageBox::information(this, "Сохранение", "Файл сохранён: " + fileName);
 }
 
@@ -160,7 +315,8 @@ void MainWindow::addRow() {
     table->setItem(row, 5, new QTableWidgetItem("0.0"));
     table->setItem(row, 6, new QTableWidgetItem("0.0"));
     table->blockSignals(false);
-    drawRectangles();
+    hasUnsavedEdits = true;
+    scheduleRedraw();
 }
 
 void MainWindow::removeRow() {
@@ -172,20 +328,24 @@ void MainWindow::removeRow() {
     for (int r : rows) table->removeRow(r);
     table->blockSignals(false);
     renumberRows();
-    drawRectangles();
+    hasUnsavedEdits = true;
+    scheduleRedraw();
 }
 
 void MainWindow::onTableSelectionChanged() {
     if (isSyncingSelection) return;
+    // после правки номера рядов в индексе устарели, выделение перенесётся в applyGeometry
+    if (currentFrame.generation != geometryGeneration) return;
     isSyncingSelection = true;
-    for (QGraphicsItem* it : scene->selectedItems()) it->setSelected(false);
-    auto sel = table->selectionModel()->selectedRows();
-    for (const QModelIndex &idx : sel) {
-        int row = idx.row();
-        for (QGraphicsItem* it : scene->items()) {
-            QVariant v = it->data(ROW_ROLE);
-            if (v.isValid() && v.toInt() == row) {
-                it->setSelected(true);
+    {
+        // одно массовое обновление сцены без сигнала на каждый элемент
+        QSignalBlocker blocker(scene);
+        scene->clearSelection();
+        const QItemSelection sel = table->selectionModel()->selection();
+        for (const QItemSelectionRange &range : sel) {
+            for (int row = range.top(); row <= range.bottom(); ++row) {
+                if (row < 0 || row >= rowItems.size()) continue;
+                for (QGraphicsItem *it : rowItems[row]) it->setSelected(true);
             }
         }
     }
@@ -194,33 +354,44 @@ void MainWindow::onTableSelectionChanged() {
 
 void MainWindow::onSceneSelectionChanged() {
     if (isSyncingSelection) return;
+    if (currentFrame.generation != geometryGeneration) return;
     isSyncingSelection = true;
-    table->selectionModel()->clearSelection();
     QSet<int> rowsToSelect;
     static const int INTERSECT_AREA_ROLE = 2;
     QList<QGraphicsItem*> selected = scene->selectedItems();
     // 1) обычный выбор по элементам
     for (QGraphicsItem* it : selected) {
-        QVariant v = it->data(ROW_ROLE);
-        if (v.isValid()) rowsToSelect.insert(v.toInt());
+        auto found = itemRows.constFind(it);
+        if (found != itemRows.constEnd()) rowsToSelect.insert(found.value());
     }
     // 2) если выбран оверлей пересечения, выделяем все объекты, фигуры которых пересекают область
-    for (QGraphicsItem* it : selected) {
-        QVariant a = it->data(INTERSECT_AREA_ROLE);
-        if (a.isValid()) {
+    {
+        QSignalBlocker blocker(scene);
+        for (QGraphicsItem* it : selected) {
+            QVariant a = it->data(INTERSECT_AREA_ROLE);
+            if (!a.isValid()) continue;
             QRectF area = a.toRectF();
-            for (QGraphicsItem* all : scene->items()) {
-                QVariant vr = all->data(ROW_ROLE);
-                if (!vr.isValid()) continue;
-                QRectF br = all->sceneBoundingRect();
-                if (br.intersects(area)) {
-                    rowsToSelect.insert(vr.toInt());
-                    all->setSelected(true);
-                }
+            for (QGraphicsItem* all : scene->items(area, Qt::IntersectsItemBoundingRect)) {
+                auto found = itemRows.constFind(all);
+                if (found == itemRows.constEnd()) continue;
+                if (!all->sceneBoundingRect().intersects(area)) continue;
+                rowsToSelect.insert(found.value());
+                all->setSelected(true);
             }
         }
     }
-    for (int row : rowsToSelect) table->selectRow(row);
+    // 3) одно выделение в таблице: соседние ряды склеиваются в диапазоны
+    QList<int> rows = rowsToSelect.values();
+    std::sort(rows.begin(), rows.end());
+    QItemSelection selection;
+    const int lastColumn = table->columnCount() - 1;
+    for (int i = 0; i < rows.size(); ) {
+        int first = rows[i];
+        int last = first;
+        while (++i < rows.size() && rows[i] == last + 1) last = rows[i];
+        selection.select(table->model()->index(first, 0), table->model()->index(last, lastColumn));
+    }
+    table->selectionModel()->select(selection, QItemSelectionModel::ClearAndSelect | QItemSelectionModel::Rows);
     isSyncingSelection = false;
 }
 
@@ -228,218 +399,337 @@ void MainWindow::onTableCellChanged(int row, int column) {
     Q_UNUSED(column);
     if (row < 0 || row >= table->rowCount()) return;
     if (!isRedrawing) {
-        drawRectangles();
+        hasUnsavedEdits = true;
+        scheduleRedraw();
     }
 }
 
+MainWindow::EditTransaction::EditTransaction(MainWindow *window)
+    : w(window)
+    , wasBlocked(window->table->blockSignals(true))
+{
+    if (w->editDepth++ == 0) w->editChanges = 0;
+}
+
+MainWindow::EditTransaction::~EditTransaction() {
+    w->table->blockSignals(wasBlocked);
+    if (--w->editDepth > 0) return;
+    // пустая вставка или сдвиг на 0;0 таблицу не меняют: ни пометки, ни пересчёта
+    if (w->editChanges == 0) return;
+    w->hasUnsavedEdits = true;
+    w->scheduleRedraw();
+}
+
+void MainWindow::scheduleRedraw() {
+    ++geometryGeneration; // всё, что считалось до этой правки, уже устарело
+    redrawTimer->start();
+}
+
 void MainWindow::drawRectangles() {
     if (!scene) return;
     if (isRedrawing) return;
-    isRedrawing = true;
-    table->blockSignals(true);
-    qDebug() << "очищение сцены";
-    scene->clear();
-    struct R { int r; QRectF rect; ObjectType type; };
-    QVector<R> rects;
-    qDebug() << "рисуем ряд " << table->rowCount();
-
-    // панорама: 3840x512px
-    const double PANORAMA_WIDTH = 3840.0;
-    const double PANORAMA_HEIGHT = 512.0;
-    const double DEG_PER_PX = 360.0 / PANORAMA_WIDTH; // 0.09375 гр/пикс
+    if (editDepth > 0) return; // транзакция сама запросит перерисовку при завершении
+    // считаем не больше одного снимка за раз, свежий запрос подождёт текущий
+    if (geometryWatcher->isRunning()) { geometryPending = true; return; }
+    geometryPending = false;
+    qDebug() << "геометрия: поколение" << geometryGeneration << "рядов" << table->rowCount();
+    geometryWatcher->setFuture(QtConcurrent::run(&PanoramaGeometry::compute, snapshotInputs(), geometryGeneration));
+}
 
+QVector<PanoramaGeometry::Input> MainWindow::snapshotInputs() const {
+    QVector<PanoramaGeometry::Input> inputs;
+    inputs.reserve(table->rowCount());
     for (int row=0; row<table->rowCount(); ++row) {
+        PanoramaGeometry::Input in;
+        in.row = row;
+        CsvHandler::Record &rec = in.rec;
         bool ok = true;
-        int x1 = table->item(row,1) ? table->item(row,1)->text().toInt(&ok) : 0;
-        if (!ok) { ok=true; continue; }
-        int y1 = table->item(row,2) ? table->item(row,2)->text().toInt(&ok) : 0;
-        if (!ok) { ok=true; continue; }
-        int x2 = table->item(row,3) ? table->item(row,3)->text().toInt(&ok) : 0;
-        if (!ok) { ok=true; continue; }
-        int y2 = table->item(row,4) ? table->item(row,4)->text().toInt(&ok) : 0;
-        if (!ok) { ok=true; continue; }
+        rec.x1 = table->item(row,1) ? table->item(row,1)->text().toInt(&ok) : 0;
+        if (!ok) continue;
+        rec.y1 = table->item(row,2) ? table->item(row,2)->text().toInt(&ok) : 0;
+        if (!ok) continue;
+        rec.x2 = table->item(row,3) ? table->item(row,3)->text().toInt(&ok) : 0;
+        if (!ok) continue;
+        rec.y2 = table->item(row,4) ? table->item(row,4)->text().toInt(&ok) : 0;
+        if (!ok) continue;
         bool okd = true;
-        double dAz = table->item(row,5) ? table->item(row,5)->text().replace(',', '.').toDouble(&okd) : 0.0;
-        if (!okd) dAz = 0.0;
+        rec.azimuth = table->item(row,5) ? table->item(row,5)->text().replace(',', '.').toDouble(&okd) : 0.0;
+        if (!okd) rec.azimuth = 0.0;
         okd = true;
-        double dEl = table->item(row,6) ? table->item(row,6)->text().replace(',', '.').toDouble(&okd) : 0.0;
-        if (!okd) dEl = 0.0;
+        rec.elevation = table->item(row,6) ? table->item(row,6)->text().replace(',', '.').toDouble(&okd) : 0.0;
+        if (!okd) rec.elevation = 0.0;
+        inputs.append(in);
+    }
+    return inputs;
+}
 
+void MainWindow::onGeometryReady() {
+    PanoramaGeometry::Frame frame = geometryWatcher->result();
+    if (geometryPending) drawRectangles();
+    if (frame.generation != geometryGeneration) {
+        qDebug() << "геометрия: устаревшее поколение" << frame.generation << "отброшено";
+        return;
+    }
+    applyGeometry(frame);
+}
 
-        if (x1 > x2 || y1 > y2) {
-            qDebug() << "рисуем ряд " << row+1 << ": пропуск (start > end: x1=" << x1 << ">x2=" << x2 << " or y1=" << y1 << ">y2=" << y2 << ")";
-            continue;
-        }
+void MainWindow::applyGeometry(const PanoramaGeometry::Frame &frame) {
+    isRedrawing = true;
+    table->blockSignals(true);
+    qDebug() << "очищение сцены";
+    clearRowIndex();
+    {
+        // очистка сцены не должна сбрасывать выделение в таблице
+        QSignalBlocker blocker(scene);
+        scene->clear();
+    }
+    rowItems.resize(table->rowCount());
+    currentFrame = frame;
 
+    for (const PanoramaGeometry::Shape &r : frame.shapes) {
+        const bool red = frame.intersectRows.contains(r.row);
+        addShapeItem(r, red);
+        paintTableRow(r.row, red);
+    }
 
-        ObjectType objType = getObjectType(x1, y1, x2, y2);
-        
-
-        double dx = dAz / DEG_PER_PX;
-        double dy = -dEl / DEG_PER_PX;
-        
-        QPointF p1 = QPointF(x1 + dx, y1 + dy);
-        QPointF p2 = QPointF(x2 + dx, y2 + dy);
-        
-        auto wrapX = [PANORAMA_WIDTH](double x) -> double {
-            while (x < 0) x += PANORAMA_WIDTH;
-            while (x >= PANORAMA_WIDTH) x -= PANORAMA_WIDTH;
-            return x;
-        };
-
-        const double V_PERIOD = 3840.0;
-        auto wrapY = [V_PERIOD](double y) -> double {
-            double r = std::fmod(y, V_PERIOD);
-            if (r < 0) r += V_PERIOD;
-            return r;
-        };
-        auto appendVisibleYSegments = [&](double bx1, double by1, double bx2, double by2) {
-
-            double wy1 = wrapY(by1);
-            double wy2 = wrapY(by2);
-            auto emitSegment = [&](double segY1, double segY2) {
-                double a = qMax(0.0, qMin(PANORAMA_HEIGHT, segY1));
-                double b = qMax(0.0, qMin(PANORAMA_HEIGHT, segY2));
-                if (a == b) {
-
-                    if (a <= 0.0 || a >= PANORAMA_HEIGHT) return;
-                }
-                if (a > b) std::swap(a, b);
-                if (b <= 0.0 || a >= PANORAMA_HEIGHT) return;
-                QRectF rr(bx1, a, bx2 - bx1, b - a);
-                rects.append({row, rr, objType});
-                qDebug() << "рисуем ряд" << row+1 << " видимый seg (x,y,w,h)=" << rr.x() << rr.y() << rr.width() << rr.height();
-            };
-            if (wy1 <= wy2) {
-
-                emitSegment(wy1, wy2);
-            } else {
-
-                emitSegment(wy1, V_PERIOD);
-                emitSegment(0.0, wy2);
-            }
-        };
-        
+    for (const QRectF &inter : frame.intersections) addIntersectionItem(inter);
 
-        double x1_wrapped = wrapX(p1.x());
-        double x2_wrapped = wrapX(p2.x());
-        
+    for (QGraphicsItem* it : scene->selectedItems()) {
+        QGraphicsRectItem *ri = qgraphicsitem_cast<QGraphicsRectItem*>(it);
+        if (ri) ri->setPen(QPen(Qt::blue, 2));
+    }
 
-        if (qAbs(x1_wrapped - x2_wrapped) > PANORAMA_WIDTH / 2) {
+    table->blockSignals(false);
+    isRedrawing = false;
 
-            QPointF left_p1 = QPointF(x1_wrapped, p1.y());
-            QPointF left_p2 = QPointF(PANORAMA_WIDTH, p2.y());
-            if (left_p1.x() < left_p2.x()) {
+    // выделение таблицы переносится на новые элементы сцены
+    onTableSelectionChanged();
+}
 
-                appendVisibleYSegments(left_p1.x(), left_p1.y(), left_p2.x(), left_p2.y());
-            }
+QVector<int> MainWindow::selectedRowList() const {
+    QVector<int> rows;
+    const QItemSelection sel = table->selectionModel()->selection();
+    for (const QItemSelectionRange &range : sel) {
+        for (int row = range.top(); row <= range.bottom(); ++row) rows.append(row);
+    }
+    std::sort(rows.begin(), rows.end());
+    rows.erase(std::unique(rows.begin(), rows.end()), rows.end());
+    return rows;
+}
 
-            QPointF right_p1 = QPointF(0, p1.y());
-            QPointF right_p2 = QPointF(x2_wrapped, p2.y());
-            if (right_p1.x() < right_p2.x()) {
-                appendVisibleYSegments(right_p1.x(), right_p1.y(), right_p2.x(), right_p2.y());
-            }
-            continue;
-        }
-        
-        p1.setX(x1_wrapped);
-        p2.setX(x2_wrapped);
-        
-        appendVisibleYSegments(p1.x(), p1.y(), p2.x(), p2.y());
-        qDebug() << "рисуем ряд" << row+1 << ": тип" << (objType==ObjectType::Point?"точка":objType==ObjectType::Line?"линия":"прямоугольник")
-                 << " dAz=" << dAz << " dEl=" << dEl;
-    }
-
-    QSet<int> intersectRows;
-    for (int i=0; i<rects.size(); ++i) {
-        for (int j=i+1; j<rects.size(); ++j) {
-            if (rects[i].rect.intersects(rects[j].rect)) {
-                qDebug() << "пересечение: ряды " << rects[i].r+1 << "и" << rects[j].r+1
-                         << " area=" << rects[i].rect.intersected(rects[j].rect);
-                intersectRows.insert(rects[i].r);
-                intersectRows.insert(rects[j].r);
-            }
-        }
+bool MainWindow::recordFromRow(int row, CsvHandler::Record &rec) const {
+    bool ok = true;
+    for (int c = 1; c <= 6; ++c) {
+        if (!table->item(row, c)) return false;
     }
+    rec.x1 = table->item(row,1)->text().toInt(&ok); if (!ok) return false;
+    rec.y1 = table->item(row,2)->text().toInt(&ok); if (!ok) return false;
+    rec.x2 = table->item(row,3)->text().toInt(&ok); if (!ok) return false;
+    rec.y2 = table->item(row,4)->text().toInt(&ok); if (!ok) return false;
+    rec.azimuth = table->item(row,5)->text().replace(',', '.').toDouble(&ok); if (!ok) return false;
+    rec.elevation = table->item(row,6)->text().replace(',', '.').toDouble(&ok); if (!ok) return false;
+    return true;
+}
 
-    for (const R &r : rects) {
-        QGraphicsItem *item = nullptr;
-        QPen pen(Qt::green, 2);
-        
-        if (r.type == ObjectType::Point) {
-            // точка
-            QGraphicsLineItem *line1 = new QGraphicsLineItem(r.rect.x()-3, r.rect.y()-3, r.rect.x()+3, r.rect.y()+3);
-            QGraphicsLineItem *line2 = new QGraphicsLineItem(r.rect.x()-3, r.rect.y()+3, r.rect.x()+3, r.rect.y()-3);
-            line1->setData(ROW_ROLE, r.r);
-            line2->setData(ROW_ROLE, r.r);
-            line1->setFlag(QGraphicsItem::ItemIsSelectable, true);
-            line2->setFlag(QGraphicsItem::ItemIsSelectable, true);
-            line1->setPen(pen);
-            line2->setPen(pen);
-            scene->addItem(line1);
-            scene->addItem(line2);
-            item = line1;
-        }
-        else if (r.type == ObjectType::Line) {
-            // отрезок
-            auto *lineItem = new QGraphicsLineItem(r.rect.x(), r.rect.y(), r.rect.x() + r.rect.width(), r.rect.y() + r.rect.height());
-            lineItem->setPen(pen);
-            lineItem->setData(ROW_ROLE, r.r);
-            lineItem->setFlag(QGraphicsItem::ItemIsSelectable, true);
-            scene->addItem(lineItem);
-            item = lineItem;
-        }
-        else {
-            // прямоугольник
-            auto rectItem = scene->addRect(r.rect, pen);
-            rectItem->setBrush(Qt::NoBrush);
-            item = rectItem;
-        }
+void MainWindow::writeRecordToRow(int row, const CsvHandler::Record &rec) {
+    const QString texts[] = {
+        QString::number(rec.x1), QString::number(rec.y1), QString::number(rec.x2), QString::number(rec.y2),
+        QString::number(rec.azimuth, 'f', 2), QString::number(rec.elevation, 'f', 2)
+    };
+    for (int c = 1; c <= 6; ++c) {
+        QTableWidgetItem *it = table->item(row, c);
+        if (!it) table->setItem(row, c, new QTableWidgetItem(texts[c-1]));
+        else if (it->text() != texts[c-1]) it->setText(texts[c-1]);
+        else continue;
+        ++editChanges;
+    }
+}
 
-        if (item) {
-            item->setFlag(QGraphicsItem::ItemIsSelectable, true);
-            item->setData(ROW_ROLE, r.r);
-            
-            if (intersectRows.contains(r.r)) {
-                if (auto shape = qgraphicsitem_cast<QAbstractGraphicsShapeItem*>(item)) {
-                    shape->setPen(QPen(Qt::red, 2));
-                } else if (auto line = qgraphicsitem_cast<QGraphicsLineItem*>(item)) {
-                    line->setPen(QPen(Qt::red, 2));
-                }
-                for (int c=0;c<table->columnCount();++c) {
-                    QTableWidgetItem *it = table->item(r.r,c);
-                    if (!it) it = new QTableWidgetItem(), table->setItem(r.r,c, it);
-                    it->setBackground(Qt::red);
-                }
-            }
-            else {
-                for (int c=0;c<table->columnCount();++c) {
-                    if (table->item(r.r,c)) table->item(r.r,c)->setBackground(Qt::white);
-                }
-            }
-        }
+void MainWindow::pasteRows() {
+    const QString text = QGuiApplication::clipboard()->text();
+    if (text.isEmpty()) return;
+
+    // строки таблицы из буфера: XНач;YНач;XКон;YКон;Азимут;Угол, допускается столбец № впереди и табуляция
+    static const QRegularExpression sep("[;\t]");
+    QVector<CsvHandler::Record> records;
+    int skipped = 0;
+    for (const QString &raw : text.split('\n')) {
+        const QString line = raw.trimmed();
+        if (line.isEmpty()) continue;
+        QStringList f = line.split(sep);
+        if (f.size() == 7) f.removeFirst();
+        bool ok = f.size() == 6;
+        CsvHandler::Record r;
+        if (ok) r.x1 = f[0].trimmed().toInt(&ok);
+        if (ok) r.y1 = f[1].trimmed().toInt(&ok);
+        if (ok) r.x2 = f[2].trimmed().toInt(&ok);
+        if (ok) r.y2 = f[3].trimmed().toInt(&ok);
+        if (ok) r.azimuth = f[4].trimmed().replace(',', '.').toDouble(&ok);
+        if (ok) r.elevation = f[5].trimmed().replace(',', '.').toDouble(&ok);
+        if (!ok) { ++skipped; continue; }
+        records.append(r);
     }
 
-    static const int INTERSECT_AREA_ROLE = 2;
-    for (int i=0; i<rects.size(); ++i) {
-        for (int j=i+1; j<rects.size(); ++j) {
-            QRectF inter = rects[i].rect.intersected(rects[j].rect);
-            if (!inter.isEmpty()) {
-                QGraphicsRectItem *over = scene->addRect(inter, QPen(Qt::NoPen), QBrush(QColor(200,0,0,150)));
-                over->setZValue(1);
-                over->setFlag(QGraphicsItem::ItemIsSelectable, true);
-                over->setData(INTERSECT_AREA_ROLE, inter);
-            }
+    {
+        EditTransaction tx(this);
+        for (const auto &r : records) appendTableRow(r);
+    }
+    qDebug() << "вставлено рядов:" << records.size() << "пропущено:" << skipped;
+    if (skipped) statusBar()->showMessage(QString("Вставлено: %1, пропущено строк: %2").arg(records.size()).arg(skipped), 5000);
+}
+
+bool MainWindow::readSelectedRecords(QVector<int> &rows, QVector<CsvHandler::Record> &records) const {
+    // выделенные ряды читаются одним проходом, нечитаемые пропускаются
+    rows.clear();
+    records.clear();
+    for (int row : selectedRowList()) {
+        CsvHandler::Record rec;
+        if (!recordFromRow(row, rec)) continue;
+        rows.append(row);
+        records.append(rec);
+    }
+    return !rows.isEmpty();
+}
+
+void MainWindow::writeRecords(const QVector<int> &rows, const QVector<CsvHandler::Record> &records) {
+    EditTransaction tx(this);
+    for (int i = 0; i < rows.size(); ++i) writeRecordToRow(rows[i], records[i]);
+}
+
+void MainWindow::shiftOffsets() {
+    QVector<int> rows;
+    QVector<CsvHandler::Record> records;
+    if (!readSelectedRecords(rows, records)) return;
+    bool ok = false;
+    QString input = QInputDialog::getText(this, "Сдвиг смещений", "ΔАзимут;ΔУгол", QLineEdit::Normal, "0.00;0.00", &ok);
+    if (!ok) return;
+    QStringList parts = input.replace(',', '.').split(';');
+    bool okAz = false, okEl = false;
+    double dAz = parts.value(0).trimmed().toDouble(&okAz);
+    double dEl = parts.value(1).trimmed().toDouble(&okEl);
+    if (!okAz || !okEl) { QMessageBox::warning(this, "Сдвиг смещений", "Ожидается: ΔАзимут;ΔУгол"); return; }
+
+    for (auto &rec : records) {
+        rec.azimuth += dAz;
+        rec.elevation += dEl;
+    }
+    writeRecords(rows, records);
+}
+
+void MainWindow::scaleOffsets() {
+    QVector<int> rows;
+    QVector<CsvHandler::Record> records;
+    if (!readSelectedRecords(rows, records)) return;
+    bool ok = false;
+    double k = QInputDialog::getDouble(this, "Масштаб смещений", "Множитель", 1.0, -1000.0, 1000.0, 3, &ok);
+    if (!ok) return;
+
+    for (auto &rec : records) {
+        rec.azimuth *= k;
+        rec.elevation *= k;
+    }
+    writeRecords(rows, records);
+}
+
+void MainWindow::moveRegions() {
+    QVector<int> rows;
+    QVector<CsvHandler::Record> records;
+    if (!readSelectedRecords(rows, records)) return;
+    bool ok = false;
+    QString input = QInputDialog::getText(this, "Переместить области", "ΔX;ΔY (пиксели)", QLineEdit::Normal, "0;0", &ok);
+    if (!ok) return;
+    QStringList parts = input.split(';');
+    bool okX = false, okY = false;
+    int dx = parts.value(0).trimmed().toInt(&okX);
+    int dy = parts.value(1).trimmed().toInt(&okY);
+    if (!okX || !okY) { QMessageBox::warning(this, "Переместить области", "Ожидается: ΔX;ΔY"); return; }
+
+    QVector<int> movedRows;
+    QVector<CsvHandler::Record> moved;
+    int skipped = 0;
+    for (int i = 0; i < records.size(); ++i) {
+        CsvHandler::Record rec = records[i];
+        const int minX = qMin(rec.x1, rec.x2), maxX = qMax(rec.x1, rec.x2);
+        const int minY = qMin(rec.y1, rec.y2), maxY = qMax(rec.y1, rec.y2);
+        // область за пределами панорамы не двигаем: для неё границы сдвига не определены
+        if (minX < 0 || maxX > 3839 || minY < 0 || maxY > 511) { ++skipped; continue; }
+        // область сдвигается целиком и упирается в край панорамы, размер сохраняется
+        int sx = qBound(-minX, dx, 3839 - maxX);
+        int sy = qBound(-minY, dy, 511 - maxY);
+        rec.x1 += sx; rec.x2 += sx;
+        rec.y1 += sy; rec.y2 += sy;
+        movedRows.append(rows[i]);
+        moved.append(rec);
+    }
+    if (!moved.isEmpty()) writeRecords(movedRows, moved);
+    if (skipped) {
+        qDebug() << "перемещение: пропущено рядов вне панорамы:" << skipped;
+        statusBar()->showMessage(QString("Перемещено: %1, пропущено рядов вне панорамы: %2").arg(moved.size()).arg(skipped), 5000);
+    }
+}
+
+void MainWindow::addShapeItem(const PanoramaGeometry::Shape &r, bool intersecting) {
+    QPen pen(intersecting ? Qt::red : Qt::green, 2);
+    if (r.type == ObjectType::Point) {
+        // точка
+        QGraphicsLineItem *line1 = new QGraphicsLineItem(r.rect.x()-3, r.rect.y()-3, r.rect.x()+3, r.rect.y()+3);
+        QGraphicsLineItem *line2 = new QGraphicsLineItem(r.rect.x()-3, r.rect.y()+3, r.rect.x()+3, r.rect.y()-3);
+        for (QGraphicsLineItem *line : {line1, line2}) {
+            line->setPen(pen);
+            line->setFlag(QGraphicsItem::ItemIsSelectable, true);
+            line->setData(ROW_ROLE, r.row);
+            scene->addItem(line);
+            registerRowItem(r.row, line);
         }
+        return;
     }
 
-    for (QGraphicsItem* it : scene->selectedItems()) {
-        QGraphicsRectItem *ri = qgraphicsitem_cast<QGraphicsRectItem*>(it);
-        if (ri) ri->setPen(QPen(Qt::blue, 2));
+    QGraphicsItem *item = nullptr;
+    if (r.type == ObjectType::Line) {
+        // отрезок
+        auto *lineItem = new QGraphicsLineItem(r.rect.x(), r.rect.y(), r.rect.x() + r.rect.width(), r.rect.y() + r.rect.height());
+        lineItem->setPen(pen);
+        scene->addItem(lineItem);
+        item = lineItem;
     }
+    else {
+        // прямоугольник
+        auto rectItem = scene->addRect(r.rect, pen);
+        rectItem->setBrush(Qt::NoBrush);
+        item = rectItem;
+    }
+    item->setFlag(QGraphicsItem::ItemIsSelectable, true);
+    item->setData(ROW_ROLE, r.row);
+    registerRowItem(r.row, item);
+}
 
-    table->blockSignals(false);
-    isRedrawing = false;
+void MainWindow::addIntersectionItem(const QRectF &inter) {
+    static const int INTERSECT_AREA_ROLE = 2;
+    QGraphicsRectItem *over = scene->addRect(inter, QPen(Qt::NoPen), QBrush(QColor(200,0,0,150)));
+    over->setZValue(1);
+    over->setFlag(QGraphicsItem::ItemIsSelectable, true);
+    over->setData(INTERSECT_AREA_ROLE, inter);
+}
+
+void MainWindow::setItemPen(QGraphicsItem *item, const QPen &pen) {
+    // у QAbstractGraphicsShapeItem нет своего Type, qgraphicsitem_cast к нему срабатывает для любого элемента
+    if (auto line = qgraphicsitem_cast<QGraphicsLineItem*>(item)) {
+        line->setPen(pen);
+    } else if (auto shape = dynamic_cast<QAbstractGraphicsShapeItem*>(item)) {
+        shape->setPen(pen);
+    }
+}
+
+void MainWindow::paintTableRow(int row, bool intersecting) {
+    for (int c=0;c<table->columnCount();++c) {
+        QTableWidgetItem *it = table->item(row,c);
+        if (intersecting) {
+            if (!it) it = new QTableWidgetItem(), table->setItem(row,c, it);
+            it->setBackground(Qt::red);
+        } else if (it) {
+            it->setBackground(Qt::white);
+        }
+    }
 }
 
 void MainWindow::renumberRows() {
@@ -453,6 +743,18 @@ void MainWindow::renumberRows() {
     }
 }
 
+void MainWindow::clearRowIndex() {
+    rowItems.clear();
+    itemRows.clear();
+}
+
+void MainWindow::registerRowItem(int row, QGraphicsItem *item) {
+    if (row < 0) return;
+    if (row >= rowItems.size()) rowItems.resize(row + 1);
+    rowItems[row].append(item);
+    itemRows.insert(item, row);
+}
+
 bool MainWindow::hasValidationErrors(QString &msg) const {
     struct R { QRectF rect; int row; };
     QVector<R> rects;
@@ -480,9 +782,7 @@ bool MainWindow::hasValidationErrors(QString &msg) const {
 }
 
 ObjectType MainWindow::getObjectType(int x1, int y1, int x2, int y2) const {
-    if (x1 == x2 && y1 == y2) return ObjectType::Point;
-    if ((x1 == x2) != (y1 == y2)) return ObjectType::Line;  // только одна сторона
-    return ObjectType::Rectangle;
+    return PanoramaGeometry::objectType(x1, y1, x2, y2);
 }
 
 void MainWindow::testPanoramaMath() {
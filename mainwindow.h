@@ -11,20 +11,19 @@
 #include <QMessageBox>
 #include <QFileDialog>
 #include <QVector>
+#include <QHash>
 #include <QPointF>
+#include <QTimer>
+#include <QFutureWatcher>
 #include <cmath>
 #include "csvhandler.h"
+#include "filefollower.h"
+#include "panoramageometry.h"
 
 QT_BEGIN_NAMESPACE
 namespace Ui { class MainWindow; }
 QT_END_NAMESPACE
 
-enum class ObjectType {
-    Rectangle,
-    Line,
-    Point
-};
-
 class MainWindow : public QMainWindow {
     Q_OBJECT
 
@@ -40,17 +39,66 @@ private slots:
     void onTableSelectionChanged();
     void onSceneSelectionChanged();
     void onTableCellChanged(int row, int column);
+    void toggleFollow(bool enabled);
+    void onFollowReloaded();
+    void onFollowAppended(int first, int count);
+    void onFollowFailed(const QString &error);
+    void pasteRows();
+    void shiftOffsets();
+    void scaleOffsets();
+    void moveRegions();
+    void onGeometryReady();
 
 private:
     Ui::MainWindow *ui;
     QGraphicsScene *scene;
     QTableWidget  *table;
+    FileFollower *follower;
+    QTimer *redrawTimer;
+    int editDepth = 0;
+    int editChanges = 0; // изменённых ячеек и рядов в текущей транзакции
+    QFutureWatcher<PanoramaGeometry::Frame> *geometryWatcher;
+    quint64 geometryGeneration = 0; // растёт с каждой правкой
+    PanoramaGeometry::Frame currentFrame; // по нему построены сцена и индекс рядов
+    bool geometryPending = false;
+    QString currentFileName;
+    bool hasUnsavedEdits = false;
     bool isSyncingSelection = false; // защита от рекурсивных сигналов
     bool isRedrawing = false; // защита от перерисовки
-    
 
+    // двусторонний индекс ряд <-> элементы сцены, перестраивается в applyGeometry
+    QVector<QVector<QGraphicsItem*>> rowItems;
+    QHash<QGraphicsItem*, int> itemRows;
+
+    // правки внутри транзакции копятся, перерисовка одна на следующем такте цикла событий
+    class EditTransaction {
+    public:
+        explicit EditTransaction(MainWindow *window);
+        ~EditTransaction();
+    private:
+        MainWindow *w;
+        bool wasBlocked;
+    };
+
+    void scheduleRedraw();
     void drawRectangles();
+    QVector<PanoramaGeometry::Input> snapshotInputs() const;
+    void applyGeometry(const PanoramaGeometry::Frame &frame);
+    void addShapeItem(const PanoramaGeometry::Shape &r, bool intersecting);
+    void addIntersectionItem(const QRectF &inter);
+    void setItemPen(QGraphicsItem *item, const QPen &pen);
+    void paintTableRow(int row, bool intersecting);
+    bool confirmDiscardEdits();
+    QVector<int> selectedRowList() const;
+    bool recordFromRow(int row, CsvHandler::Record &rec) const;
+    void writeRecordToRow(int row, const CsvHandler::Record &rec);
+    bool readSelectedRecords(QVector<int> &rows, QVector<CsvHandler::Record> &records) const;
+    void writeRecords(const QVector<int> &rows, const QVector<CsvHandler::Record> &records);
+    void fillTable(const CsvHandler::Result &res);
+    void appendTableRow(const CsvHandler::Record &r);
     void renumberRows();
+    void clearRowIndex();
+    void registerRowItem(int row, QGraphicsItem *item);
     bool hasValidationErrors(QString &msg) const;
     
     ObjectType getObjectType(int x1, int y1, int x2, int y2) const;
@@ -0,0 +1,123 @@
+#include "occupancymap.h"
+#include <QtAlgorithms>
+#include <QHash>
+
+OccupancyMap::OccupancyMap()
+    : covered(WORDS_PER_ROW * HEIGHT, 0)
+    , overlap(WORDS_PER_ROW * HEIGHT, 0)
+{}
+
+void OccupancyMap::clear() {
+    covered.fill(0);
+    overlap.fill(0);
+}
+
+void OccupancyMap::add(const CsvHandler::Record &r) {
+    // точки и отрезки - метки, а не области: на экране они не пересекаются (см. PanoramaGeometry::findIntersections)
+    if (r.x1 == r.x2 || r.y1 == r.y2) return;
+    int x1 = qMax(0, qMin(r.x1, r.x2));
+    int x2 = qMin(WIDTH - 1, qMax(r.x1, r.x2));
+    int y1 = qMax(0, qMin(r.y1, r.y2));
+    int y2 = qMin(HEIGHT - 1, qMax(r.y1, r.y2));
+    if (x1 > x2 || y1 > y2) return;
+
+    // маски крайних слов, внутренние слова заливаются целиком
+    const int w1 = x1 >> 6;
+    const int w2 = x2 >> 6;
+    const quint64 firstMask = ~quint64(0) << (x1 & 63);
+    const quint64 lastMask = ~quint64(0) >> (63 - (x2 & 63));
+
+    quint64 *cov = covered.data();
+    quint64 *ovl = overlap.data();
+    for (int y = y1; y <= y2; ++y) {
+        const int base = y * WORDS_PER_ROW;
+        for (int w = w1; w <= w2; ++w) {
+            quint64 mask = ~quint64(0);
+            if (w == w1) mask &= firstMask;
+            if (w == w2) mask &= lastMask;
+            ovl[base + w] |= cov[base + w] & mask;
+            cov[base + w] |= mask;
+        }
+    }
+}
+
+// первый x >= from, где бит равен value, или WIDTH
+static int nextBit(const quint64 *row, int from, bool value) {
+    int w = from >> 6;
+    if (w >= OccupancyMap::WORDS_PER_ROW) return OccupancyMap::WIDTH;
+    quint64 word = (value ? row[w] : ~row[w]) & (~quint64(0) << (from & 63));
+    while (!word) {
+        if (++w >= OccupancyMap::WORDS_PER_ROW) return OccupancyMap::WIDTH;
+        word = value ? row[w] : ~row[w];
+    }
+    return (w << 6) + int(qCountTrailingZeroBits(word));
+}
+
+// отрезки бит value по строкам, одинаковые отрезки соседних строк склеиваются в прямоугольник
+static void collectAreas(const QVector<quint64> &bits, bool value, int maxAreas,
+                         QVector<OccupancyMap::Area> &out, int &total) {
+    total = 0;
+    QHash<quint32, int> open; // (x1,x2) -> индекс области, продолжающейся на текущей строке
+    QHash<quint32, int> next;
+    QVector<OccupancyMap::Area> areas;
+    for (int y = 0; y < OccupancyMap::HEIGHT; ++y) {
+        const quint64 *row = bits.constData() + y * OccupancyMap::WORDS_PER_ROW;
+        next.clear();
+        int x = 0;
+        while (x < OccupancyMap::WIDTH) {
+            int start = nextBit(row, x, value);
+            if (start >= OccupancyMap::WIDTH) break;
+            int end = nextBit(row, start, !value) - 1;
+            quint32 key = (quint32(start) << 16) | quint32(end);
+            auto it = open.constFind(key);
+            if (it != open.constEnd()) {
+                areas[it.value()].y2 = y;
+                next.insert(key, it.value());
+            } else {
+                next.insert(key, areas.size());
+                areas.append({start, y, end, y});
+            }
+            x = end + 1;
+        }
+        open.swap(next);
+    }
+    total = areas.size();
+    out = areas.mid(0, maxAreas);
+}
+
+OccupancyMap::Report OccupancyMap::analyze(int maxAreas) const {
+    Report rep;
+    for (int i = 0; i < covered.size(); ++i) {
+        rep.coveredPixels += qPopulationCount(covered[i]);
+        rep.overlapPixels += qPopulationCount(overlap[i]);
+    }
+    if (rep.coveredPixels < qint64(WIDTH) * HEIGHT) collectAreas(covered, false, maxAreas, rep.uncovered, rep.uncoveredCount);
+    if (rep.overlapPixels > 0) collectAreas(overlap, true, maxAreas, rep.overlaps, rep.overlapCount);
+    return rep;
+}
+
+OccupancyMap::Report OccupancyMap::check(const QVector<CsvHandler::Record> &records, int maxAreas) {
+    OccupancyMap map;
+    for (const auto &r : records) map.add(r);
+    return map.analyze(maxAreas);
+}
+
+QString OccupancyMap::describe(const Report &rep, int maxLines) {
+    QString text = QString("Покрытие панорамы: %1%\n").arg(rep.coveragePercent(), 0, 'f', 2);
+    auto listAreas = [&text, maxLines](const QVector<Area> &areas, int total) {
+        for (int i = 0; i < areas.size() && i < maxLines; ++i) {
+            const Area &a = areas[i];
+            text += QString("  X %1-%2, Y %3-%4\n").arg(a.x1).arg(a.x2).arg(a.y1).arg(a.y2);
+        }
+        if (total > maxLines) text += QString("  ... ещё %1\n").arg(total - maxLines);
+    };
+    if (rep.uncoveredCount > 0) {
+        text += QString("Непокрытых областей: %1\n").arg(rep.uncoveredCount);
+        listAreas(rep.uncovered, rep.uncoveredCount);
+    }
+    if (rep.overlapPixels > 0) {
+        text += QString("Пересечений: %1 пикс. в %2 областях\n").arg(rep.overlapPixels).arg(rep.overlapCount);
+        listAreas(rep.overlaps, rep.overlapCount);
+    }
+    return text;
+}
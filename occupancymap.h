@@ -0,0 +1,51 @@
+#ifndef OCCUPANCYMAP_H
+#define OCCUPANCYMAP_H
+
+#include <QVector>
+#include <QString>
+#include "csvhandler.h"
+
+// битовая карта занятости панорамы 3840x512 (один бит на пиксель, ~240 КБ).
+// записи заливаются словами по 64 бита, второй слой копит пиксели, занятые повторно
+class OccupancyMap {
+public:
+    static constexpr int WIDTH = 3840;
+    static constexpr int HEIGHT = 512;
+    static constexpr int WORDS_PER_ROW = WIDTH / 64;
+
+    // прямоугольная область, концы включительно
+    struct Area {
+        int x1;
+        int y1;
+        int x2;
+        int y2;
+    };
+
+    struct Report {
+        qint64 coveredPixels = 0;
+        qint64 overlapPixels = 0;
+        int uncoveredCount = 0;     // всего непокрытых областей
+        int overlapCount = 0;       // всего областей пересечения
+        QVector<Area> uncovered;    // первые maxAreas областей
+        QVector<Area> overlaps;
+
+        double coveragePercent() const { return 100.0 * coveredPixels / (qint64(WIDTH) * HEIGHT); }
+        bool hasFaults() const { return overlapPixels > 0 || coveredPixels < qint64(WIDTH) * HEIGHT; }
+    };
+
+    OccupancyMap();
+
+    void clear();
+    void add(const CsvHandler::Record &r); // точки и отрезки пропускаются
+    Report analyze(int maxAreas = 100) const;
+
+    static Report check(const QVector<CsvHandler::Record> &records, int maxAreas = 100);
+    // текст отчёта: покрытие, пересечения и первые maxLines областей каждого вида
+    static QString describe(const Report &rep, int maxLines = 10);
+
+private:
+    QVector<quint64> covered;
+    QVector<quint64> overlap;
+};
+
+#endif
@@ -0,0 +1,147 @@
+#include "offsetcatalog.h"
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QSet>
+#include <QtConcurrent>
+#include <QDebug>
+
+static const quint32 CATALOG_MAGIC = 0x4F464354; // "OFCT"
+static const quint16 CATALOG_FORMAT = 2; // 2: версия протокола проверяется при разборе шапки
+
+static OffsetCatalog::Entry scanFile(const QFileInfo &info) {
+    OffsetCatalog::Entry e;
+    e.path = info.absoluteFilePath();
+    e.size = info.size();
+    e.mtime = info.lastModified().toMSecsSinceEpoch();
+    e.valid = CsvHandler().loadHeader(e.path, e.header, e.count, e.error);
+    return e;
+}
+
+static QDataStream &operator<<(QDataStream &out, const OffsetCatalog::Entry &e) {
+    return out << e.path << e.size << e.mtime << e.valid << e.error
+               << qint32(e.header.machineNumber) << e.header.date << e.header.time
+               << qint32(e.header.version) << e.header.commentTextLines << qint32(e.count);
+}
+
+static QDataStream &operator>>(QDataStream &in, OffsetCatalog::Entry &e) {
+    qint32 machine = 0, version = 0, count = 0;
+    in >> e.path >> e.size >> e.mtime >> e.valid >> e.error
+       >> machine >> e.header.date >> e.header.time >> version >> e.header.commentTextLines >> count;
+    e.header.machineNumber = machine;
+    e.header.version = version;
+    e.count = count;
+    return in;
+}
+
+OffsetCatalog::OffsetCatalog(const QString &cacheFile)
+    : cachePath(cacheFile)
+{}
+
+QString OffsetCatalog::defaultCacheFile(const QString &directory) {
+    return QDir(directory).filePath(".panorama-catalog");
+}
+
+bool OffsetCatalog::load() {
+    items.clear();
+    QFile f(cachePath);
+    if (!f.open(QIODevice::ReadOnly)) return false;
+    QDataStream in(&f);
+    in.setVersion(QDataStream::Qt_5_12);
+    quint32 magic = 0;
+    quint16 format = 0;
+    qint32 n = 0;
+    in >> magic >> format >> n;
+    if (magic != CATALOG_MAGIC || format != CATALOG_FORMAT) return false;
+    items.reserve(qMax(0, n));
+    for (qint32 i = 0; i < n && in.status() == QDataStream::Ok; ++i) {
+        Entry e;
+        in >> e;
+        items.insert(e.path, e);
+    }
+    if (in.status() != QDataStream::Ok) {
+        items.clear();
+        return false;
+    }
+    return true;
+}
+
+bool OffsetCatalog::save(QString &outError) const {
+    QSaveFile f(cachePath);
+    if (!f.open(QIODevice::WriteOnly)) { outError = "Не удалось записать кэш каталога: " + cachePath; return false; }
+    QDataStream out(&f);
+    out.setVersion(QDataStream::Qt_5_12);
+    out << CATALOG_MAGIC << CATALOG_FORMAT << qint32(items.size());
+    for (const Entry &e : items) out << e;
+    if (out.status() != QDataStream::Ok || !f.commit()) { outError = "Не удалось записать кэш каталога: " + cachePath; return false; }
+    return true;
+}
+
+OffsetCatalog::Stats OffsetCatalog::refresh(const QString &directory, bool recursive) {
+    Stats st;
+    const QString root = QDir(directory).absolutePath();
+    QDirIterator it(root, QStringList() << "*.csv", QDir::Files,
+                    recursive ? QDirIterator::Subdirectories : QDirIterator::NoIteratorFlags);
+
+    // сверка с кэшем только по stat, сами файлы не открываются
+    QSet<QString> present;
+    QVector<QFileInfo> changed;
+    while (it.hasNext()) {
+        it.next();
+        const QFileInfo info = it.fileInfo();
+        const QString path = info.absoluteFilePath();
+        present.insert(path);
+        auto cached = items.constFind(path);
+        if (cached != items.constEnd() && cached->size == info.size()
+            && cached->mtime == info.lastModified().toMSecsSinceEpoch()) continue;
+        changed.append(info);
+    }
+
+    const QVector<Entry> scanned = QtConcurrent::blockingMapped<QVector<Entry>>(changed, scanFile);
+    for (const Entry &e : scanned) items.insert(e.path, e);
+
+    // удаляются только пути, которые обход мог встретить: без рекурсии - лишь файлы самого каталога
+    const QString prefix = root.endsWith('/') ? root : root + '/';
+    for (auto i = items.begin(); i != items.end(); ) {
+        const bool reachable = i.key().startsWith(prefix)
+                               && (recursive || QFileInfo(i.key()).absolutePath() == root);
+        if (reachable && !present.contains(i.key())) {
+            i = items.erase(i);
+            ++st.removed;
+        } else {
+            ++i;
+        }
+    }
+
+    st.total = present.size();
+    st.scanned = scanned.size();
+    qDebug() << "каталог:" << root << "файлов" << st.total << "перечитано" << st.scanned << "удалено" << st.removed;
+    return st;
+}
+
+static bool isNewer(const OffsetCatalog::Entry &a, const OffsetCatalog::Entry *b) {
+    return !b || QDateTime(a.header.date, a.header.time) > QDateTime(b->header.date, b->header.time);
+}
+
+const OffsetCatalog::Entry *OffsetCatalog::latestFor(int machineNumber) const {
+    const Entry *best = nullptr;
+    for (const Entry &e : items) {
+        if (!e.valid || e.header.machineNumber != machineNumber) continue;
+        if (isNewer(e, best)) best = &e;
+    }
+    return best;
+}
+
+QMap<int, const OffsetCatalog::Entry*> OffsetCatalog::latestByMachine() const {
+    QMap<int, const Entry*> latest;
+    for (const Entry &e : items) {
+        if (!e.valid) continue;
+        const Entry *&best = latest[e.header.machineNumber];
+        if (isNewer(e, best)) best = &e;
+    }
+    return latest;
+}
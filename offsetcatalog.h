@@ -0,0 +1,49 @@
+#ifndef OFFSETCATALOG_H
+#define OFFSETCATALOG_H
+
+#include <QString>
+#include <QHash>
+#include <QMap>
+#include "csvhandler.h"
+
+// каталог файлов смещений: по каждому файлу хранится только шапка.
+// кэш на диске с ключом путь/размер/время изменения, при обновлении
+// перечитываются только изменившиеся файлы, параллельно
+class OffsetCatalog {
+public:
+    struct Entry {
+        QString path;
+        qint64 size = 0;
+        qint64 mtime = 0; // мс от эпохи
+        bool valid = false;
+        QString error;
+        CsvHandler::Header header;
+        int count = 0;
+    };
+
+    struct Stats {
+        int total = 0;
+        int scanned = 0;
+        int removed = 0;
+    };
+
+    explicit OffsetCatalog(const QString &cacheFile);
+
+    bool load();
+    bool save(QString &outError) const;
+    Stats refresh(const QString &directory, bool recursive = true);
+
+    const QHash<QString, Entry> &entries() const { return items; }
+    // самая свежая по дате/времени шапки таблица машины, или nullptr
+    const Entry *latestFor(int machineNumber) const;
+    // самая свежая таблица каждой машины, по номеру машины
+    QMap<int, const Entry*> latestByMachine() const;
+
+    static QString defaultCacheFile(const QString &directory);
+
+private:
+    QString cachePath;
+    QHash<QString, Entry> items;
+};
+
+#endif
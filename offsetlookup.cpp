@@ -0,0 +1,53 @@
+#include "offsetlookup.h"
+#include <algorithm>
+
+static const int PANORAMA_WIDTH = 3840;
+static const int PANORAMA_HEIGHT = 512;
+
+OffsetLookup::OffsetLookup(const CsvHandler::Result &result)
+    : res(result)
+    , cols((PANORAMA_WIDTH + CELL - 1) / CELL)
+    , rows((PANORAMA_HEIGHT + CELL - 1) / CELL)
+    , cells(cols * rows)
+{
+    for (int i = 0; i < res.records.size(); ++i) {
+        const auto &r = res.records[i];
+        int cx1 = qBound(0, qMin(r.x1, r.x2) / CELL, cols - 1);
+        int cx2 = qBound(0, qMax(r.x1, r.x2) / CELL, cols - 1);
+        int cy1 = qBound(0, qMin(r.y1, r.y2) / CELL, rows - 1);
+        int cy2 = qBound(0, qMax(r.y1, r.y2) / CELL, rows - 1);
+        for (int cy = cy1; cy <= cy2; ++cy) {
+            for (int cx = cx1; cx <= cx2; ++cx) cells[cy * cols + cx].append(i);
+        }
+    }
+}
+
+const CsvHandler::Record *OffsetLookup::find(int x, int y) const {
+    if (x < 0 || y < 0 || x >= PANORAMA_WIDTH || y >= PANORAMA_HEIGHT) return nullptr;
+    for (int i : cells[(y / CELL) * cols + x / CELL]) {
+        const auto &r = res.records[i];
+        if (x >= r.x1 && x <= r.x2 && y >= r.y1 && y <= r.y2) return &r;
+    }
+    return nullptr;
+}
+
+QVector<int> OffsetLookup::region(int x1, int y1, int x2, int y2) const {
+    QVector<int> found;
+    if (x1 > x2) std::swap(x1, x2);
+    if (y1 > y2) std::swap(y1, y2);
+    if (x2 < 0 || y2 < 0 || x1 >= PANORAMA_WIDTH || y1 >= PANORAMA_HEIGHT) return found;
+    int cx1 = qBound(0, x1 / CELL, cols - 1), cx2 = qBound(0, x2 / CELL, cols - 1);
+    int cy1 = qBound(0, y1 / CELL, rows - 1), cy2 = qBound(0, y2 / CELL, rows - 1);
+    for (int cy = cy1; cy <= cy2; ++cy) {
+        for (int cx = cx1; cx <= cx2; ++cx) {
+            for (int i : cells[cy * cols + cx]) {
+                const auto &r = res.records[i];
+                if (r.x1 <= x2 && r.x2 >= x1 && r.y1 <= y2 && r.y2 >= y1) found.append(i);
+            }
+        }
+    }
+    // запись, задевающая несколько ячеек, попадает в список несколько раз
+    std::sort(found.begin(), found.end());
+    found.erase(std::unique(found.begin(), found.end()), found.end());
+    return found;
+}
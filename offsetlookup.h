@@ -0,0 +1,29 @@
+#ifndef OFFSETLOOKUP_H
+#define OFFSETLOOKUP_H
+
+#include <QVector>
+#include "csvhandler.h"
+
+// неизменяемая структура поиска записи по пикселю: панорама разбита на ячейки,
+// в каждой ячейке индексы записей, которые её задевают (в порядке файла)
+class OffsetLookup {
+public:
+    static const int CELL = 64;
+
+    explicit OffsetLookup(const CsvHandler::Result &result);
+
+    // первая по порядку файла запись, содержащая пиксель, или nullptr
+    const CsvHandler::Record *find(int x, int y) const;
+    // индексы записей, пересекающих область (концы включительно)
+    QVector<int> region(int x1, int y1, int x2, int y2) const;
+
+    const CsvHandler::Result &result() const { return res; }
+
+private:
+    CsvHandler::Result res;
+    int cols;
+    int rows;
+    QVector<QVector<int>> cells;
+};
+
+#endif
@@ -0,0 +1,163 @@
+#include "offsetservice.h"
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QFileSystemWatcher>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QTimer>
+#include <QtConcurrent>
+#include <QDebug>
+
+static const int REBUILD_DELAY_MS = 200;
+static const int POLL_INTERVAL_MS = 2000;
+
+OffsetService::OffsetService(const QString &filename, QObject *parent)
+    : QObject(parent)
+    , path(filename)
+    , server(new QLocalServer(this))
+    , watcher(new QFileSystemWatcher(this))
+    , debounce(new QTimer(this))
+    , pollTimer(new QTimer(this))
+{
+    // запись файла приходит несколькими уведомлениями, перестраиваем один раз
+    debounce->setSingleShot(true);
+    debounce->setInterval(REBUILD_DELAY_MS);
+    connect(debounce, &QTimer::timeout, this, &OffsetService::rebuild);
+    connect(watcher, &QFileSystemWatcher::fileChanged, this, &OffsetService::scheduleRebuild);
+    // уведомление теряется, если файл удалили и создали заново, - редкий stat подстраховывает
+    pollTimer->setInterval(POLL_INTERVAL_MS);
+    connect(pollTimer, &QTimer::timeout, this, &OffsetService::poll);
+    connect(&builder, &QFutureWatcher<Build>::finished, this, &OffsetService::onRebuilt);
+    connect(server, &QLocalServer::newConnection, this, &OffsetService::onNewConnection);
+}
+
+bool OffsetService::start(const QString &socketName, QString &outError) {
+    Build b = buildLookup(path);
+    if (!b.lookup) { outError = b.error; return false; }
+    std::atomic_store(&lookup, b.lookup);
+    gen = 1;
+
+    QLocalServer::removeServer(socketName); // сокет, оставшийся от упавшего процесса
+    if (!server->listen(socketName)) { outError = "Не удалось открыть сокет: " + server->errorString(); return false; }
+    watcher->addPath(path);
+    stamp = fileStamp();
+    pollTimer->start();
+    qInfo() << "сервис смещений:" << server->fullServerName() << "записей:" << b.lookup->result().records.size();
+    return true;
+}
+
+OffsetService::Build OffsetService::buildLookup(const QString &filename) {
+    Build b;
+    CsvHandler::Result res;
+    if (!CsvHandler().load(filename, res, b.error)) return b;
+    b.lookup = std::make_shared<const OffsetLookup>(res);
+    return b;
+}
+
+void OffsetService::scheduleRebuild() {
+    // при замене через переименование наблюдатель теряет файл
+    if (!watcher->files().contains(path) && QFileInfo::exists(path)) watcher->addPath(path);
+    stamp = fileStamp();
+    debounce->start();
+}
+
+void OffsetService::poll() {
+    if (fileStamp() != stamp) scheduleRebuild();
+}
+
+QPair<qint64, qint64> OffsetService::fileStamp() const {
+    const QFileInfo info(path);
+    if (!info.exists()) return qMakePair(qint64(-1), qint64(-1));
+    return qMakePair(info.size(), info.lastModified().toMSecsSinceEpoch());
+}
+
+void OffsetService::rebuild() {
+    if (builder.isRunning()) { rebuildPending = true; return; }
+    builder.setFuture(QtConcurrent::run(&OffsetService::buildLookup, path));
+}
+
+void OffsetService::onRebuilt() {
+    Build b = builder.result();
+    if (b.lookup) {
+        std::atomic_store(&lookup, b.lookup);
+        ++gen;
+        qInfo() << "таблица смещений обновлена, поколение" << gen << "записей:" << b.lookup->result().records.size();
+    } else {
+        // файл мог быть недописан, продолжаем отвечать по старой таблице
+        qWarning() << "таблица не перестроена:" << b.error;
+    }
+    if (rebuildPending) {
+        rebuildPending = false;
+        rebuild();
+    }
+}
+
+void OffsetService::onNewConnection() {
+    while (QLocalSocket *socket = server->nextPendingConnection()) {
+        connect(socket, &QLocalSocket::readyRead, this, &OffsetService::onReadyRead);
+        connect(socket, &QLocalSocket::disconnected, socket, &QObject::deleteLater);
+    }
+}
+
+void OffsetService::onReadyRead() {
+    auto *socket = qobject_cast<QLocalSocket*>(sender());
+    if (!socket) return;
+    // одна копия таблицы на всю пачку строк, подмена её не затрагивает
+    std::shared_ptr<const OffsetLookup> table = current();
+    QByteArray reply;
+    while (socket->canReadLine()) {
+        reply += handleRequest(socket->readLine().trimmed(), *table, gen);
+        reply += '\n';
+    }
+    if (!reply.isEmpty()) socket->write(reply);
+}
+
+static QByteArray offsetText(const CsvHandler::Record &r, char sep) {
+    return QByteArray::number(r.azimuth, 'f', 2) + sep + QByteArray::number(r.elevation, 'f', 2);
+}
+
+QByteArray OffsetService::handleRequest(const QByteArray &line, const OffsetLookup &table, int generation) {
+    QList<QByteArray> parts = line.split(';');
+    const QByteArray cmd = parts.value(0).trimmed().toLower();
+    bool ok1 = false, ok2 = false, ok3 = false, ok4 = false;
+
+    if (cmd == "px") {
+        int x = parts.value(1).toInt(&ok1);
+        int y = parts.value(2).toInt(&ok2);
+        if (!ok1 || !ok2) return "error;некорректный пиксель";
+        const CsvHandler::Record *r = table.find(x, y);
+        return r ? "ok;" + offsetText(*r, ';') : QByteArray("none");
+    }
+    if (cmd == "pxs") {
+        QByteArray reply = "pxs";
+        for (int i = 1; i < parts.size(); ++i) {
+            QList<QByteArray> xy = parts[i].split(',');
+            int x = xy.value(0).toInt(&ok1);
+            int y = xy.value(1).toInt(&ok2);
+            const CsvHandler::Record *r = (ok1 && ok2) ? table.find(x, y) : nullptr;
+            reply += ';';
+            reply += r ? offsetText(*r, ',') : QByteArray("-");
+        }
+        return reply;
+    }
+    if (cmd == "region") {
+        int x1 = parts.value(1).toInt(&ok1);
+        int y1 = parts.value(2).toInt(&ok2);
+        int x2 = parts.value(3).toInt(&ok3);
+        int y2 = parts.value(4).toInt(&ok4);
+        if (!ok1 || !ok2 || !ok3 || !ok4) return "error;некорректная область";
+        QVector<int> found = table.region(x1, y1, x2, y2);
+        QByteArray reply = "region;" + QByteArray::number(found.size());
+        for (int i : found) {
+            const auto &r = table.result().records[i];
+            reply += ';' + QByteArray::number(r.x1) + ',' + QByteArray::number(r.y1) + ','
+                   + QByteArray::number(r.x2) + ',' + QByteArray::number(r.y2) + ',' + offsetText(r, ',');
+        }
+        return reply;
+    }
+    if (cmd == "info") {
+        return "info;" + QByteArray::number(table.result().header.machineNumber) + ';'
+               + QByteArray::number(table.result().records.size()) + ';' + QByteArray::number(generation);
+    }
+    return "error;неизвестная команда";
+}
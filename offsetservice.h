@@ -0,0 +1,66 @@
+#ifndef OFFSETSERVICE_H
+#define OFFSETSERVICE_H
+
+#include <QObject>
+#include <QString>
+#include <QByteArray>
+#include <QPair>
+#include <QFutureWatcher>
+#include <memory>
+#include "offsetlookup.h"
+
+class QLocalServer;
+class QLocalSocket;
+class QFileSystemWatcher;
+class QTimer;
+
+// фоновый сервис смещений: таблица загружается один раз и отдаётся по локальному сокету.
+// протокол строковый, одна строка запроса - одна строка ответа:
+//   px;x;y                 -> ok;азимут;угол | none
+//   pxs;x,y;x,y;...        -> pxs;азимут,угол;...  (промах: "-")
+//   region;x1;y1;x2;y2     -> region;n;x1,y1,x2,y2,азимут,угол;...
+//   info                   -> info;машина;записей;поколение
+// при изменении файла структура поиска строится в фоне и подменяется атомарно,
+// читатели дорабатывают со старой копией
+class OffsetService : public QObject {
+    Q_OBJECT
+
+public:
+    explicit OffsetService(const QString &filename, QObject *parent = nullptr);
+
+    bool start(const QString &socketName, QString &outError);
+
+    std::shared_ptr<const OffsetLookup> current() const { return std::atomic_load(&lookup); }
+    int generation() const { return gen; }
+
+    static QByteArray handleRequest(const QByteArray &line, const OffsetLookup &table, int generation);
+
+private slots:
+    void onNewConnection();
+    void onReadyRead();
+    void scheduleRebuild();
+    void poll();
+    void rebuild();
+    void onRebuilt();
+
+private:
+    struct Build {
+        std::shared_ptr<const OffsetLookup> lookup;
+        QString error;
+    };
+    static Build buildLookup(const QString &filename);
+    QPair<qint64, qint64> fileStamp() const; // размер и время изменения, -1 если файла нет
+
+    QString path;
+    QLocalServer *server;
+    QFileSystemWatcher *watcher;
+    QTimer *debounce;
+    QTimer *pollTimer;
+    QPair<qint64, qint64> stamp;
+    QFutureWatcher<Build> builder;
+    bool rebuildPending = false;
+    int gen = 0;
+    std::shared_ptr<const OffsetLookup> lookup;
+};
+
+#endif
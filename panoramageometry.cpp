@@ -0,0 +1,185 @@
+#include "panoramageometry.h"
+#include <QDebug>
+#include <algorithm>
+#include <cmath>
+
+static const int GRID_COLS = int(PanoramaGeometry::PANORAMA_WIDTH) / PanoramaGeometry::CELL;
+static const int GRID_ROWS = int(PanoramaGeometry::PANORAMA_HEIGHT) / PanoramaGeometry::CELL;
+
+static bool hasArea(const QRectF &r) {
+    return r.width() > 0 && r.height() > 0;
+}
+
+static void cellRange(const QRectF &r, int &cx1, int &cy1, int &cx2, int &cy2) {
+    cx1 = qBound(0, int(r.left()) / PanoramaGeometry::CELL, GRID_COLS - 1);
+    cx2 = qBound(0, int(r.right()) / PanoramaGeometry::CELL, GRID_COLS - 1);
+    cy1 = qBound(0, int(r.top()) / PanoramaGeometry::CELL, GRID_ROWS - 1);
+    cy2 = qBound(0, int(r.bottom()) / PanoramaGeometry::CELL, GRID_ROWS - 1);
+}
+
+static void indexShape(PanoramaGeometry::Frame &frame, int i) {
+    const QRectF &r = frame.shapes[i].rect;
+    if (!hasArea(r)) return;
+    int cx1, cy1, cx2, cy2;
+    cellRange(r, cx1, cy1, cx2, cy2);
+    for (int cy = cy1; cy <= cy2; ++cy) {
+        for (int cx = cx1; cx <= cx2; ++cx) frame.grid[cy * GRID_COLS + cx].append(i);
+    }
+}
+
+ObjectType PanoramaGeometry::objectType(int x1, int y1, int x2, int y2) {
+    if (x1 == x2 && y1 == y2) return ObjectType::Point;
+    if ((x1 == x2) != (y1 == y2)) return ObjectType::Line;  // только одна сторона
+    return ObjectType::Rectangle;
+}
+
+void PanoramaGeometry::project(const Input &in, QVector<Shape> &out) {
+    const CsvHandler::Record &r = in.rec;
+    if (r.x1 > r.x2 || r.y1 > r.y2) return; // start > end не рисуем
+
+    const int row = in.row;
+    const ObjectType objType = objectType(r.x1, r.y1, r.x2, r.y2);
+
+    double dx = r.azimuth / DEG_PER_PX;
+    double dy = -r.elevation / DEG_PER_PX;
+
+    QPointF p1 = QPointF(r.x1 + dx, r.y1 + dy);
+    QPointF p2 = QPointF(r.x2 + dx, r.y2 + dy);
+
+    auto wrapX = [](double x) -> double {
+        while (x < 0) x += PANORAMA_WIDTH;
+        while (x >= PANORAMA_WIDTH) x -= PANORAMA_WIDTH;
+        return x;
+    };
+
+    const double V_PERIOD = 3840.0;
+    auto wrapY = [V_PERIOD](double y) -> double {
+        double w = std::fmod(y, V_PERIOD);
+        if (w < 0) w += V_PERIOD;
+        return w;
+    };
+    auto appendVisibleYSegments = [&](double bx1, double by1, double bx2, double by2) {
+        double wy1 = wrapY(by1);
+        double wy2 = wrapY(by2);
+        auto emitSegment = [&](double segY1, double segY2) {
+            double a = qMax(0.0, qMin(PANORAMA_HEIGHT, segY1));
+            double b = qMax(0.0, qMin(PANORAMA_HEIGHT, segY2));
+            if (a == b) {
+                if (a <= 0.0 || a >= PANORAMA_HEIGHT) return;
+            }
+            if (a > b) std::swap(a, b);
+            if (b <= 0.0 || a >= PANORAMA_HEIGHT) return;
+            // при заворачивании bx1 может оказаться правее bx2, храним нормализованный прямоугольник
+            out.append({row, QRectF(bx1, a, bx2 - bx1, b - a).normalized(), objType});
+        };
+        if (wy1 <= wy2) {
+            emitSegment(wy1, wy2);
+        } else {
+            emitSegment(wy1, V_PERIOD);
+            emitSegment(0.0, wy2);
+        }
+    };
+
+    double x1_wrapped = wrapX(p1.x());
+    double x2_wrapped = wrapX(p2.x());
+
+    if (qAbs(x1_wrapped - x2_wrapped) > PANORAMA_WIDTH / 2) {
+        // объект переходит через край панорамы: две части
+        if (x1_wrapped < PANORAMA_WIDTH) appendVisibleYSegments(x1_wrapped, p1.y(), PANORAMA_WIDTH, p2.y());
+        if (0 < x2_wrapped) appendVisibleYSegments(0, p1.y(), x2_wrapped, p2.y());
+        return;
+    }
+
+    appendVisibleYSegments(x1_wrapped, p1.y(), x2_wrapped, p2.y());
+}
+
+void PanoramaGeometry::findIntersections(Frame &frame) {
+    // заметание по X: сравниваются только фигуры, перекрывающиеся по горизонтали.
+    // прямоугольники нормализованы в project, а нулевой ширины или высоты (линии, точки)
+    // QRectF::intersects не пересекает, их пропускаем сразу
+    const QVector<Shape> &shapes = frame.shapes;
+    QVector<int> order;
+    order.reserve(shapes.size());
+    for (int i = 0; i < shapes.size(); ++i) {
+        if (hasArea(shapes[i].rect)) order.append(i);
+    }
+    std::sort(order.begin(), order.end(), [&shapes](int a, int b) {
+        return shapes[a].rect.left() < shapes[b].rect.left();
+    });
+
+    QVector<int> active;
+    for (int i : order) {
+        const QRectF &cur = shapes[i].rect;
+        active.erase(std::remove_if(active.begin(), active.end(), [&](int j) {
+            return shapes[j].rect.right() <= cur.left();
+        }), active.end());
+        for (int j : active) {
+            if (!shapes[j].rect.intersects(cur)) continue;
+            frame.intersectRows.insert(shapes[j].row);
+            frame.intersectRows.insert(shapes[i].row);
+            QRectF inter = shapes[j].rect.intersected(cur);
+            if (!inter.isEmpty()) frame.intersections.append(inter);
+        }
+        active.append(i);
+    }
+}
+
+PanoramaGeometry::Frame PanoramaGeometry::compute(const QVector<Input> &inputs, quint64 generation) {
+    Frame frame;
+    frame.generation = generation;
+    frame.shapes.reserve(inputs.size());
+    for (const Input &in : inputs) project(in, frame.shapes);
+    findIntersections(frame);
+    frame.grid.resize(GRID_COLS * GRID_ROWS);
+    for (int i = 0; i < frame.shapes.size(); ++i) indexShape(frame, i);
+    qDebug() << "геометрия: поколение" << generation << "записей" << inputs.size()
+             << "фигур" << frame.shapes.size() << "пересечений" << frame.intersections.size();
+    return frame;
+}
+
+QVector<int> PanoramaGeometry::append(Frame &frame, const QVector<Input> &inputs) {
+    QVector<int> newlyIntersecting;
+    const int first = frame.shapes.size();
+    for (const Input &in : inputs) project(in, frame.shapes);
+    if (frame.grid.isEmpty()) frame.grid.resize(GRID_COLS * GRID_ROWS);
+
+    auto markRow = [&](int row) {
+        if (frame.intersectRows.contains(row)) return;
+        frame.intersectRows.insert(row);
+        newlyIntersecting.append(row);
+    };
+
+    QSet<int> checked;
+    for (int i = first; i < frame.shapes.size(); ++i) {
+        const QRectF cur = frame.shapes[i].rect;
+        if (!hasArea(cur)) continue;
+        // фигура может лежать в нескольких ячейках, каждую пару проверяем один раз
+        checked.clear();
+        int cx1, cy1, cx2, cy2;
+        cellRange(cur, cx1, cy1, cx2, cy2);
+        for (int cy = cy1; cy <= cy2; ++cy) {
+            for (int cx = cx1; cx <= cx2; ++cx) {
+                for (int j : frame.grid[cy * GRID_COLS + cx]) {
+                    if (checked.contains(j)) continue;
+                    checked.insert(j);
+                    if (!frame.shapes[j].rect.intersects(cur)) continue;
+                    markRow(frame.shapes[j].row);
+                    markRow(frame.shapes[i].row);
+                    QRectF inter = frame.shapes[j].rect.intersected(cur);
+                    if (!inter.isEmpty()) frame.intersections.append(inter);
+                }
+            }
+        }
+        indexShape(frame, i);
+    }
+    return newlyIntersecting;
+}
+
+QVector<PanoramaGeometry::Input> PanoramaGeometry::fromRecords(const QVector<CsvHandler::Record> &records) {
+    QVector<Input> inputs(records.size());
+    for (int i = 0; i < records.size(); ++i) {
+        inputs[i].row = i;
+        inputs[i].rec = records[i];
+    }
+    return inputs;
+}
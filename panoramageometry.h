@@ -0,0 +1,54 @@
+#ifndef PANORAMAGEOMETRY_H
+#define PANORAMAGEOMETRY_H
+
+#include <QVector>
+#include <QSet>
+#include <QRectF>
+#include "csvhandler.h"
+
+enum class ObjectType {
+    Rectangle,
+    Line,
+    Point
+};
+
+// геометрия панорамы без сцены: проекция со смещениями, заворачивание по краям
+// и поиск пересечений. чистые функции над снимком записей, можно звать из любого потока
+class PanoramaGeometry {
+public:
+    static constexpr double PANORAMA_WIDTH = 3840.0;
+    static constexpr double PANORAMA_HEIGHT = 512.0;
+    static constexpr double DEG_PER_PX = 360.0 / PANORAMA_WIDTH; // 0.09375 гр/пикс
+    static constexpr int CELL = 64; // ячейка сетки для дозаписи фигур
+
+    struct Input {
+        int row = 0;
+        CsvHandler::Record rec;
+    };
+
+    struct Shape {
+        int row;
+        QRectF rect;
+        ObjectType type;
+    };
+
+    // результат одного пересчёта, поколение отличает его от устаревших
+    struct Frame {
+        quint64 generation = 0;
+        QVector<Shape> shapes;
+        QSet<int> intersectRows;
+        QVector<QRectF> intersections;
+        QVector<QVector<int>> grid; // индексы фигур ненулевой площади по ячейкам CELL x CELL
+    };
+
+    static ObjectType objectType(int x1, int y1, int x2, int y2);
+    static void project(const Input &in, QVector<Shape> &out);
+    static void findIntersections(Frame &frame);
+    static Frame compute(const QVector<Input> &inputs, quint64 generation = 0);
+    // дозапись: фигуры новых записей проверяются только против соседей по сетке,
+    // возвращает ряды, которые до этого не пересекались
+    static QVector<int> append(Frame &frame, const QVector<Input> &inputs);
+    static QVector<Input> fromRecords(const QVector<CsvHandler::Record> &records);
+};
+
+#endif
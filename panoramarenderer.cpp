@@ -0,0 +1,37 @@
+#include "panoramarenderer.h"
+#include <QPainter>
+#include <QPen>
+
+QImage PanoramaRenderer::render(const CsvHandler::Result &result) {
+    QImage image(int(PanoramaGeometry::PANORAMA_WIDTH), int(PanoramaGeometry::PANORAMA_HEIGHT), QImage::Format_ARGB32_Premultiplied);
+    image.fill(Qt::black);
+    QPainter p(&image);
+    p.setRenderHints(QPainter::Antialiasing | QPainter::SmoothPixmapTransform);
+    paint(p, PanoramaGeometry::compute(PanoramaGeometry::fromRecords(result.records)));
+    p.end();
+    return image;
+}
+
+void PanoramaRenderer::paint(QPainter &p, const PanoramaGeometry::Frame &frame) {
+    const QPen green(Qt::green, 2);
+    const QPen red(Qt::red, 2);
+    p.setBrush(Qt::NoBrush);
+    for (const PanoramaGeometry::Shape &s : frame.shapes) {
+        p.setPen(frame.intersectRows.contains(s.row) ? red : green);
+        const QRectF &r = s.rect;
+        if (s.type == ObjectType::Point) {
+            // точка - крестик
+            p.drawLine(QLineF(r.x()-3, r.y()-3, r.x()+3, r.y()+3));
+            p.drawLine(QLineF(r.x()-3, r.y()+3, r.x()+3, r.y()-3));
+        } else if (s.type == ObjectType::Line) {
+            p.drawLine(QLineF(r.x(), r.y(), r.x() + r.width(), r.y() + r.height()));
+        } else {
+            p.drawRect(r);
+        }
+    }
+
+    // области пересечения поверх фигур
+    p.setPen(Qt::NoPen);
+    p.setBrush(QColor(200,0,0,150));
+    for (const QRectF &inter : frame.intersections) p.drawRect(inter);
+}
@@ -0,0 +1,18 @@
+#ifndef PANORAMARENDERER_H
+#define PANORAMARENDERER_H
+
+#include <QImage>
+#include "csvhandler.h"
+#include "panoramageometry.h"
+
+class QPainter;
+
+// отрисовка панорамы в картинку без сцены и без дисплея, правила цвета как в drawRectangles:
+// зелёные области, красные пересекающиеся ряды и полупрозрачные области пересечения
+class PanoramaRenderer {
+public:
+    static QImage render(const CsvHandler::Result &result);
+    static void paint(QPainter &p, const PanoramaGeometry::Frame &frame);
+};
+
+#endif
@@ -1,13 +1,32 @@
-QT += core gui widgets
+QT += core gui widgets network concurrent
+CONFIG += c++17
 
 SOURCES += \
     main.cpp \
     mainwindow.cpp \
-    csvhandler.cpp
+    csvhandler.cpp \
+    filefollower.cpp \
+    calibrationhistory.cpp \
+    cli.cpp \
+    offsetlookup.cpp \
+    offsetservice.cpp \
+    offsetcatalog.cpp \
+    panoramageometry.cpp \
+    occupancymap.cpp \
+    panoramarenderer.cpp
 
 HEADERS += \
     mainwindow.h \
-    csvhandler.h
+    csvhandler.h \
+    filefollower.h \
+    calibrationhistory.h \
+    cli.h \
+    offsetlookup.h \
+    offsetservice.h \
+    offsetcatalog.h \
+    panoramageometry.h \
+    occupancymap.h \
+    panoramarenderer.h
 
 FORMS += \
     mainwindow.ui